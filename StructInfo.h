@@ -2,6 +2,8 @@
 #define STRUCTINFO_H
 #include <string>
 #include <vector>
+#include <type_traits>
+#include "waybillcode.h"
 struct CarInfo
 {
     int carID;              //小车ID
@@ -10,7 +12,7 @@ struct CarInfo
 struct CarItem
 {
     int carID;
-    std::string code;       //面单信息
+    WaybillCode code;       //面单信息, 定长内联
     //int supply_station_id;  //供包台ID
     //float weight;     //货物重量
     int port_num;           //目标格口号
@@ -18,9 +20,9 @@ struct CarItem
     bool isLoaded;          //true 代表有货
     int offset;             //目标格口偏移量,时间:毫秒
     bool inside;            //目标格口是否在内圈, true = 内圈, false = 外圈
-    bool is_fault = false;  //小车是否故障, true = 故障
     int runTurn_number = 0; //运行圈数, 超过两圈就强行排口
 };
+static_assert(std::is_trivially_copyable<CarItem>::value, "CarItem 需可平凡复制, 快照复制不分配内存");
 struct OutPortInfo
 {
     int port_id;    //格口编号
@@ -31,7 +33,7 @@ struct OutPortInfo
 struct unloadInfo
 {
     int carID;
-    std::string code;
+    WaybillCode code;
     int slot;
     std::string length;
     std::string width;
@@ -0,0 +1,100 @@
+#include "cameratriggerring.h"
+#include <cmath>
+
+void CameraTriggerRing::record(int carID, clock::time_point stepTime, bool synced, double stepIntervalMs)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    stepIntervalMs_ = stepIntervalMs;
+    uint64_t seq = ++lastSeq_;
+    at(seq) = Trigger{ seq, stepTime, carID, synced };
+}
+
+CameraTriggerRing::Match CameraTriggerRing::match(clock::time_point readAt)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    Match result;
+    if (lastSeq_ == 0) {
+        ++unmatched_;
+        return result;
+    }
+    auto ageMs = [&](const Trigger& t) {
+        return std::chrono::duration<double, std::milli>(readAt - t.stepTime).count();
+    };
+    uint64_t oldest = oldestSeq();
+    if (nextSeq_ < oldest) {            //回传落后超过一整个环, 最早的触发已被覆盖
+        skipped_ += oldest - nextSeq_;
+        nextSeq_ = oldest;
+    }
+
+    const double window = windowLocked();
+    const double reference = latencyMs_ >= 0 ? latencyMs_ : (expectedLatencyMs_ > 0 ? expectedLatencyMs_ : -1.0);
+    const Trigger* picked = nullptr;
+    if (reference < 0)                  //无统计值也未配置相机延时: 跳过已超过最大延时的触发, 只接受延时合理的下一个触发
+    {
+        while (nextSeq_ <= lastSeq_ && ageMs(at(nextSeq_)) > maxLatencyMs_) {
+            ++nextSeq_;
+            ++skipped_;
+        }
+        if (nextSeq_ <= lastSeq_ && ageMs(at(nextSeq_)) >= 0) {
+            picked = &at(nextSeq_);
+            result.by = MatchBy::Sequence;
+        }
+    }
+    else if (nextSeq_ <= lastSeq_)
+    {
+        const Trigger& candidate = at(nextSeq_);
+        if (std::fabs(ageMs(candidate) - reference) <= window) {
+            picked = &candidate;
+            result.by = MatchBy::Sequence;
+        }
+    }
+    if (!picked && reference >= 0)      //按序号对不上: 在环中找回传延时最接近参考值的触发
+    {
+        double best = window + 1.0;
+        for (uint64_t seq = oldest; seq <= lastSeq_; ++seq)
+        {
+            const Trigger& t = at(seq);
+            double diff = std::fabs(ageMs(t) - reference);
+            if (diff < best) {
+                best = diff;
+                picked = &t;
+            }
+        }
+        if (picked) {
+            result.by = MatchBy::Time;
+            if (picked->seq > nextSeq_) skipped_ += picked->seq - nextSeq_;
+            log("---- [" + name_ + "] 触发序号重新对齐: [" + std::to_string(nextSeq_) + "] -> [" + std::to_string(picked->seq)
+                + "], 回传延时: [" + std::to_string(static_cast<int>(ageMs(*picked))) + "]ms");
+        }
+    }
+    if (!picked) {
+        ++unmatched_;
+        return result;
+    }
+
+    result.trigger = *picked;
+    result.latencyMs = static_cast<int64_t>(ageMs(*picked));
+    nextSeq_ = picked->seq + 1;
+    if (result.by == MatchBy::Sequence) ++bySequence_;
+    else ++byTime_;
+    double age = ageMs(*picked);
+    latencyMs_ = latencyMs_ < 0 ? age : latencyMs_ * 0.9 + age * 0.1;
+    return result;
+}
+
+void CameraTriggerRing::resync(const std::string& reason)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (nextSeq_ <= lastSeq_) skipped_ += lastSeq_ + 1 - nextSeq_;
+    nextSeq_ = lastSeq_ + 1;
+    latencyMs_ = -1;            //重连后回传延时重新统计
+    log("---- [" + name_ + "] " + reason + ", 从下一次触发开始匹配");
+}
+
+std::string CameraTriggerRing::summary()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return "按序号: [" + std::to_string(bySequence_) + "], 按时间: [" + std::to_string(byTime_) + "], 未匹配: ["
+        + std::to_string(unmatched_) + "], 跳过触发: [" + std::to_string(skipped_) + "], 回传延时: ["
+        + std::to_string(static_cast<int>(latencyMs_)) + "]ms, 窗口: [" + std::to_string(static_cast<int>(windowLocked())) + "]ms";
+}
@@ -0,0 +1,71 @@
+#ifndef CAMERATRIGGERRING_H
+#define CAMERATRIGGERRING_H
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include "logger.h"
+
+// 单台相机最近若干次触发(步进)的记录: 触发序号, 步进时间, 当时在相机下的小车号.
+// 相机每回传一帧(含 NoRead)按序号取下一个未匹配的触发; 若回传延时与统计值偏差超出窗口(丢帧/多帧),
+// 改为按时间在环中找最接近的触发并重新对齐序号, 不再因计数不一致丢弃读码.
+// 窗口不超过步进间隔的一半, 否则丢帧后下一帧仍落在窗口内, 会按序号绑定到上一辆小车.
+// 启动/重连后尚无统计值时, 第一帧以配置的相机延时为参考; 未配置时只接受延时在 [0, 最大延时] 内的触发,
+// 避免第一帧对应启动前的触发而使之后所有绑定偏移同样的车数
+class CameraTriggerRing {
+public:
+    using clock = std::chrono::steady_clock;
+    struct Trigger {
+        uint64_t seq = 0;
+        clock::time_point stepTime;
+        int carID = 0;
+        bool synced = false;        //触发时头车/步进同步, 小车号可信
+    };
+    enum class MatchBy { None, Sequence, Time };
+    struct Match {
+        MatchBy by = MatchBy::None;
+        Trigger trigger;
+        int64_t latencyMs = 0;      //回传时间 - 步进时间
+    };
+
+    explicit CameraTriggerRing(const std::string& name) : name_(name) {}
+    void setWindowMs(int ms) { windowMs_ = ms; }
+    void setExpectedLatencyMs(int ms) { expectedLatencyMs_ = ms; }     //<= 0 表示未配置
+    void setMaxLatencyMs(int ms) { maxLatencyMs_ = ms; }
+    // 步进接收线程中调用; stepIntervalMs 为拟合的步进间隔, <= 0 表示尚无拟合值, 只用配置窗口
+    void record(int carID, clock::time_point stepTime, bool synced, double stepIntervalMs = 0);
+    Match match(clock::time_point readAt);          //相机每回传一帧调用一次, readAt 为 recv 返回时间
+    void resync(const std::string& reason);         //相机重连: 丢弃未匹配的触发, 从下一次触发开始
+    std::string summary();
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    static constexpr size_t Capacity = 64;
+
+    Trigger& at(uint64_t seq) { return ring_[seq % Capacity]; }
+    double windowLocked() const { return stepIntervalMs_ > 0 ? std::min<double>(windowMs_, stepIntervalMs_ / 2) : windowMs_; }
+    uint64_t oldestSeq() const { return lastSeq_ >= Capacity ? lastSeq_ - Capacity + 1 : 1; }
+
+    std::string name_;
+    std::mutex mtx_;
+    std::array<Trigger, Capacity> ring_{};
+    uint64_t lastSeq_ = 0;          //最近一次触发的序号, 从 1 开始
+    uint64_t nextSeq_ = 1;          //下一帧回传按序号应匹配的触发
+    double latencyMs_ = -1;         //回传延时滑动平均, <0 表示尚无样本
+    int windowMs_ = 100;
+    int expectedLatencyMs_ = 0;     //配置的相机回传延时, 作为第一帧的参考
+    int maxLatencyMs_ = 1000;       //未配置相机延时时, 第一帧允许的最大回传延时
+    double stepIntervalMs_ = 0;     //最近一次触发时的拟合步进间隔
+
+    uint64_t bySequence_ = 0;
+    uint64_t byTime_ = 0;
+    uint64_t unmatched_ = 0;
+    uint64_t skipped_ = 0;          //因重新对齐跳过的触发
+};
+
+#endif // CAMERATRIGGERRING_H
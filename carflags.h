@@ -0,0 +1,47 @@
+#ifndef CARFLAGS_H
+#define CARFLAGS_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// 每辆小车的原子状态位(锁定/故障/命令在途), 任意线程无锁读写, 取代无同步读取的 std::vector<bool>
+class CarFlags {
+public:
+    enum Flag : uint8_t {
+        Locked = 1 << 0,    //人工锁定, 不下件
+        Faulty = 1 << 1,    //故障小车(error_cars), 不下件不处理空车, 不再发送命令帧
+        InFlight = 1 << 2,  //命令帧已提交, 等待回码或放弃
+    };
+    static constexpr uint8_t NoUnload = Locked | Faulty | InFlight;   //任一位置位都不下件; 下件后的重复触发由任务的 generation 校验拦截
+
+    void resize(int totalCars)      //只在初始化时调用
+    {
+        size_ = totalCars > 0 ? totalCars : 0;
+        flags_.reset(new std::atomic<uint8_t>[size_]);
+        for (int i = 0; i < size_; ++i) flags_[i].store(0, std::memory_order_relaxed);
+    }
+    int size() const { return size_; }
+
+    // 返回 true 表示状态位发生了变化
+    bool set(int carID, uint8_t flag)
+    {
+        if (!valid(carID)) return false;
+        return (flags_[carID - 1].fetch_or(flag, std::memory_order_acq_rel) & flag) == 0;
+    }
+    bool clear(int carID, uint8_t flag)
+    {
+        if (!valid(carID)) return false;
+        return (flags_[carID - 1].fetch_and(static_cast<uint8_t>(~flag), std::memory_order_acq_rel) & flag) != 0;
+    }
+    bool test(int carID, uint8_t flag) const { return (load(carID) & flag) != 0; }
+    uint8_t load(int carID) const { return valid(carID) ? flags_[carID - 1].load(std::memory_order_acquire) : 0; }
+    bool blocked(int carID) const { return test(carID, Locked | Faulty); }
+
+private:
+    bool valid(int carID) const { return carID >= 1 && carID <= size_; }
+
+    std::unique_ptr<std::atomic<uint8_t>[]> flags_;
+    int size_ = 0;
+};
+
+#endif // CARFLAGS_H
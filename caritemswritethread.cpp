@@ -6,6 +6,38 @@ CarItemsWriteThread::CarItemsWriteThread(std::vector<CarItem>& carItemsRef, std:
     : carItems_(carItemsRef), carItemsLock_(carItemsLockRef)
 {
     stopping_.store(false); // 确保初始为 false
+    std::shared_lock<std::shared_mutex> rlock(carItemsLock_);
+    for (const auto& item : carItems_) maxCarID_ = std::max(maxCarID_, item.carID);
+    submitSeq_.reset(new std::atomic<uint32_t>[maxCarID_ + 1]);
+    for (int i = 0; i <= maxCarID_; ++i) submitSeq_[i].store(0, std::memory_order_relaxed);
+    appliedSeq_.assign(maxCarID_ + 1, 0);
+    pending_.resize(maxCarID_ + 1);
+    batchMark_.assign(carItems_.size(), 0);
+    generation_.assign(carItems_.size(), 0);
+    dirty_.resize(maxCarID_);
+    publish();              // 发布初始版本
+}
+void CarItemsWriteThread::publish()
+{
+    auto prev = snapshot_.load();
+    auto snap = std::make_shared<CarItemsSnapshot>();
+    snap->items = carItems_;
+    snap->generation = generation_;
+    if (prev->items.size() == carItems_.size())       //增量: 复制上一版本的调度字段, 只改变化的行
+    {
+        snap->table = prev->table;
+        for (int idx : batchChanged_) snap->table.setRow(idx, carItems_[idx]);
+    }
+    else
+    {
+        snap->table.build(carItems_);
+    }
+    snapshot_.publish(std::move(snap));
+    for (int idx : batchChanged_) {         //发布之后再置位, 调度线程取到的小车一定能在新快照中看到
+        dirty_.mark(carItems_[idx].carID);
+        batchMark_[idx] = 0;
+    }
+    batchChanged_.clear();
 }
 void CarItemsWriteThread::startLoop()
 {
@@ -51,172 +83,165 @@ int CarItemsWriteThread::indexForCarID_nocheck(int carID)
     }
     return -1;
 }
-void CarItemsWriteThread::writeSlotInfo(int carID, int port_num, int position, int offset, bool inside)
+
+void CarItemsWriteThread::submit(Event ev, const Expect& expect)
 {
-    // 尝试立即同步写（非阻塞）
-    std::unique_lock<std::shared_mutex> wlock(carItemsLock_, std::try_to_lock);
-    if (wlock.owns_lock()) {
-        int idx = indexForCarID_nocheck(carID);
-        if (idx >= 0) {
-            carItems_[idx].port_num = port_num;
-            carItems_[idx].targetPosition = position;
-            carItems_[idx].offset = offset;
-            carItems_[idx].inside = inside;
-            carItems_[idx].isLoaded = true;
-            log("---- [write slotInfo] Sync car_id: [" + std::to_string(carID) + "], slot_id: [" + std::to_string(port_num) + "], position: [" + std::to_string(position) + "]");
-        }
+    ev.expect = expect;
+    if (ev.carID < 1 || ev.carID > maxCarID_) {
+        log("---- [writeThread] 小车号: [" + std::to_string(ev.carID) + "] 不存在, 丢弃写事件!");
         return;
     }
+    // 领取序号与入队之间可能被同一小车的其他生产者插队, 写线程按序号重排
+    ev.seq = submitSeq_[ev.carID].fetch_add(1, std::memory_order_relaxed);
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    bool reported = false;
+    while (!ring_.tryPush(ev))      //队列满: 不能丢弃(会留下序号空洞), 让出时间片等待写线程
     {
-        std::lock_guard<std::mutex> lk(qMutex_);
-        q_.push(Event::MakeWriteSlot(carID, port_num, position, offset, inside));
-    }
-    qCv_.notify_one();
-}
-
-//void CarItemsWriteThread::writeItemInfo(int carID, std::string code)    //上件，转圈数为0
-//{
-//    std::unique_lock<std::shared_mutex> wlock(carItemsLock_, std::try_to_lock);
-//    if (wlock.owns_lock()) {
-//        int idx = indexForCarID_nocheck(carID);
-//        if (idx >= 0) {
-//            carItems_[idx].code = code;
-//            carItems_[idx].runTurn_number = 0;
-//            carItems_[idx].isLoaded = true;
-//        }
-//        return;
-//    }
-//    {
-//        std::lock_guard<std::mutex> lk(qMutex_);
-//        q_.push(Event::MakeWriteItem(carID, code));
-//    }
-//    qCv_.notify_one();
-//}
-void CarItemsWriteThread::writeItemInfo(int carID, std::string code)
-{
-    std::unique_lock<std::shared_mutex> wlock(carItemsLock_, std::try_to_lock);
-    if (wlock.owns_lock()) {
-        int idx = indexForCarID_nocheck(carID);
-        if (idx >= 0) {
-            carItems_[idx].code = code;
-            carItems_[idx].runTurn_number = 0;
-            if (!carItems_[idx].code.empty()) carItems_[idx].isLoaded = true;
-            log("---- [writeItem] sync car=" + std::to_string(carID) + " idx=" + std::to_string(idx) + " code=" + carItems_[idx].code);
+        ringFull_.fetch_add(1, std::memory_order_relaxed);
+        if (!reported) {
+            reported = true;
+            log("---- [writeThread] 写事件队列已满, 等待写线程处理, car=" + std::to_string(ev.carID));
         }
-        return;
+        std::this_thread::yield();
     }
+    std::atomic_thread_fence(std::memory_order_seq_cst);     //入队对写线程可见后再检查休眠标志
+    if (sleeping_.load(std::memory_order_relaxed))
     {
         std::lock_guard<std::mutex> lk(qMutex_);
-        auto ev = Event::MakeWriteItem(carID, std::move(code)); // ensure move
-        q_.push(std::move(ev));
-        log("---- [queue] queued WriteItem car=" + std::to_string(carID) + " qsize=" + std::to_string(q_.size()));
+        qCv_.notify_one();
     }
-    qCv_.notify_one();
 }
 
-void CarItemsWriteThread::setRunNum(int carID, int runTurn_number)
+void CarItemsWriteThread::writeSlotInfo(int carID, int port_num, int position, int offset, bool inside, const Expect& expect)
+{
+    submit(Event::MakeWriteSlot(carID, port_num, position, offset, inside), expect);
+}
+
+void CarItemsWriteThread::writeItemInfo(int carID, const WaybillCode& code, const Expect& expect)
+{
+    submit(Event::MakeWriteItem(carID, code), expect);
+}
+
+void CarItemsWriteThread::setRunNum(int carID, int runTurn_number, const Expect& expect)
 {
-    std::unique_lock<std::shared_mutex> wlock(carItemsLock_, std::try_to_lock);
-    if (wlock.owns_lock()) {
-        int idx = indexForCarID_nocheck(carID);
-        if (idx >= 0) carItems_[idx].runTurn_number = runTurn_number;
+    submit(Event::MakeSetRunNum(carID, runTurn_number), expect);
+}
+
+void CarItemsWriteThread::initCarItem(int carID, const Expect& expect)
+{
+    submit(Event::MakeInitItem(carID), expect);
+}
+
+void CarItemsWriteThread::apply(const Event& ev)
+{
+    int idx = indexForCarID_nocheck(ev.carID);
+    if (idx < 0) return;
+    const Expect& expect = ev.expect;
+    if (((expect.mask & Expect::Generation) && generation_[idx] != expect.generation)
+        || ((expect.mask & Expect::Code) && carItems_[idx].code != expect.code))
+    {
+        conflicts_.fetch_add(1, std::memory_order_relaxed);
+        log("---- [writeThread] 条件不满足, 丢弃写入! car_id: [" + std::to_string(ev.carID) + "], 事件: [" + std::to_string(static_cast<int>(ev.type))
+            + "], 代数: [" + std::to_string(generation_[idx]) + "/" + std::to_string(expect.generation) + "], 单号: [" + carItems_[idx].code + "/" + expect.code + "]");
         return;
     }
-    {
-        std::lock_guard<std::mutex> lk(qMutex_);
-        q_.push(Event::MakeSetRunNum(carID, runTurn_number));
+    ++generation_[idx];
+    if (!batchMark_[idx]) {
+        batchMark_[idx] = 1;
+        batchChanged_.push_back(idx);
+    }
+    CarItem& item = carItems_[idx];
+    if (ev.type == EventType::WriteSlot) {
+        item.port_num = ev.port_num;
+        item.targetPosition = ev.position;
+        item.offset = ev.offset;
+        item.inside = ev.inside;
+        item.isLoaded = true;
+        log("---- [write slotInfo] car_id: [" + std::to_string(ev.carID) + "], slot_id: [" + std::to_string(ev.port_num) + "], position: [" + std::to_string(ev.position) + "]");
+    }
+    else if (ev.type == EventType::WriteItem) {
+        item.code = ev.code;
+        item.runTurn_number = ev.runTurn_number;
+        if (!item.code.empty()) item.isLoaded = true;
+        log("---- [write itemInfo] car_id: [" + std::to_string(ev.carID) + "], code: [" + ev.code + "]");
+    }
+    else if (ev.type == EventType::SetRunNum) {
+        item.runTurn_number = ev.runTurn_number;
+    }
+    else if (ev.type == EventType::InitItem) {
+        item.code.clear();              //面单号为空
+        item.port_num = -1;             //格口号初始化
+        item.targetPosition = -1;       // 初始时无下件目标，可设为 -1 表示无目标
+        item.isLoaded = false;          // 初始状态均为未装货
+        item.offset = -1;               // 格口偏移量初始化
+        item.inside = false;            //目标格口是否在内圈, true = 内圈, false = 外圈
+        item.runTurn_number = 0;        //运行圈数, 超过两圈就强行排口
+        log("---- [write initItem] car_id: [" + std::to_string(ev.carID) + "]");
     }
-    qCv_.notify_one();
 }
 
-void CarItemsWriteThread::initCarItem(int carID)
+bool CarItemsWriteThread::drainRing()
 {
-    std::unique_lock<std::shared_mutex> wlock(carItemsLock_, std::try_to_lock);
-    if (wlock.owns_lock())
+    bool changed = false;
+    Event ev;
+    while (ring_.tryPop(ev))
     {
-        int idx = indexForCarID_nocheck(carID);
-        if (idx >= 0) {
-            carItems_[idx].code = "";                 //面单号为空
-            carItems_[idx].port_num = -1;             //格口号初始化
-            carItems_[idx].targetPosition = -1;       // 初始时无下件目标，可设为 -1 表示无目标
-            carItems_[idx].isLoaded = false;          // 初始状态均为未装货
-            carItems_[idx].offset = -1;               // 格口偏移量初始化
-            carItems_[idx].inside = false;            //目标格口是否在内圈, true = 内圈, false = 外圈
-            carItems_[idx].runTurn_number = 0;        //运行圈数, 超过两圈就强行排口
+        uint32_t& expected = appliedSeq_[ev.carID];
+        if (ev.seq != expected) {       //前序事件的生产者尚未完成入队, 暂存
+            pending_[ev.carID].push_back(ev);
+            continue;
+        }
+        apply(ev);
+        ++expected;
+        applied_.fetch_add(1, std::memory_order_relaxed);
+        changed = true;
+        auto& waiting = pending_[ev.carID];
+        bool progressed = true;
+        while (progressed && !waiting.empty())      //按序号补齐暂存的后续事件
+        {
+            progressed = false;
+            for (size_t i = 0; i < waiting.size(); ++i)
+            {
+                if (waiting[i].seq != expected) continue;
+                apply(waiting[i]);
+                ++expected;
+                applied_.fetch_add(1, std::memory_order_relaxed);
+                waiting.erase(waiting.begin() + i);
+                progressed = true;
+                break;
+            }
         }
-        return;
-    }
-    {
-        std::lock_guard<std::mutex> lk(qMutex_);
-        q_.push(Event::MakeInitItem(carID));
     }
-    qCv_.notify_one();
+    return changed;
 }
+
 void CarItemsWriteThread::workerLoop()
 {
     while (true) {
-        log("---- [writeThread] in write thread!");
-        std::queue<Event> local_q;
+        if (ring_.empty())
         {
             std::unique_lock<std::mutex> lk(qMutex_);
-            qCv_.wait(lk, [this] { return stopping_.load() || !q_.empty(); });
-            if (stopping_.load() && q_.empty()) break;
-            std::swap(local_q, q_);
+            sleeping_.store(true, std::memory_order_relaxed);       //先声明休眠再检查队列, 与 submit 的入队/检查顺序相反, 不会丢唤醒
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            qCv_.wait_for(lk, std::chrono::milliseconds(100), [this] { return stopping_.load() || !ring_.empty(); });
+            sleeping_.store(false, std::memory_order_relaxed);
+            if (stopping_.load() && ring_.empty()) break;
         }
 
         // 批量处理事件时持有写锁以减少频繁上锁/解锁
         std::unique_lock<std::shared_mutex> wlock(carItemsLock_);
-        while (!local_q.empty()) {
-            Event ev = std::move(local_q.front());
-            local_q.pop();
-
-            int idx = indexForCarID_nocheck(ev.carID);
-            if (ev.type == EventType::WriteSlot) {
-                if (idx >= 0) {
-                    carItems_[idx].port_num = ev.port_num;
-                    carItems_[idx].targetPosition = ev.position;
-                    carItems_[idx].offset = ev.offset;
-                    carItems_[idx].inside = ev.inside;
-                    carItems_[idx].isLoaded = true;
-                    log("---- [write slotInfo] Wait car_id: [" + std::to_string(ev.carID) + "], slot_id: [" + std::to_string(ev.port_num) + "], position: [" + std::to_string(ev.position) + "]");
-                }
-            }
-            else if (ev.type == EventType::WriteItem) {
-                if (idx >= 0) {
-                    carItems_[idx].code = ev.code;
-                    carItems_[idx].runTurn_number = ev.runTurn_number;
-                    carItems_[idx].isLoaded = true;
-                    log("---- [write itemInfo] Wait car_id: [" + std::to_string(ev.carID) + "], code: [" + ev.code + "]");
-                }
-            }
-            else if (ev.type == EventType::SetRunNum) {
-                if (idx >= 0) {
-                    carItems_[idx].runTurn_number = ev.runTurn_number;
-                }
-            }
-            else if (ev.type == EventType::InitItem) {
-                if (idx >= 0) {
-                    carItems_[idx].port_num = -1;             //格口号初始化
-                    carItems_[idx].targetPosition = -1;       // 初始时无下件目标，可设为 -1 表示无目标
-                    carItems_[idx].isLoaded = false;          // 初始状态均为未装货
-                    carItems_[idx].offset = -1;               // 格口偏移量初始化
-                    carItems_[idx].inside = false;            //目标格口是否在内圈, true = 内圈, false = 外圈
-                    carItems_[idx].runTurn_number = 0;        //运行圈数, 超过两圈就强行排口
-                    log("---- [write initItem] Wait car_id: [" + std::to_string(ev.carID) + "]");
-                }
-            }
-        }
+        bool changed = drainRing();
+        if (!changed) continue;
+        publish();
+        wlock.unlock();
+        notifyChanged();
     }
     log("---- [writeThread] Write loop exit!");
 }
 
 void CarItemsWriteThread::waitUntilIdle()
 {
-    while (true) {
-        {
-            std::lock_guard<std::mutex> lk(qMutex_);
-            if (q_.empty()) break;
-        }
+    while (applied_.load(std::memory_order_relaxed) < submitted_.load(std::memory_order_relaxed)) {
         std::this_thread::sleep_for(std::chrono::milliseconds(2));
     }
 }
@@ -4,12 +4,37 @@
 #include <vector>
 #include <thread>
 #include <shared_mutex>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include <string>
+#include <functional>
 #include "Logger.h"
+#include "publishedsnapshot.h"
+#include "cartable.h"
+#include "mpscring.h"
+#include "dirtycarset.h"
+
+// 写线程发布的不可变小车状态: 小车信息 + 调度字段的结构数组 + 每辆小车的代数
+struct CarItemsSnapshot {
+    std::vector<CarItem> items;
+    CarTable table;
+    std::vector<uint32_t> generation;       //下标同 items, 该小车每次被写入后加 1
+};
+
+// 小车信息唯一写入者: 各线程提交的写事件进入有界无锁环形队列, 由写线程批量应用并发布快照.
+// 每个事件带有该小车的提交序号, 同一小车的事件严格按提交顺序生效(迟到的 WriteSlot 不会覆盖之后的 InitItem)
+// 条件写入: 写线程应用事件时小车仍满足条件才生效, 否则丢弃并计数. 代数取自调用方读到的快照
+struct CarItemExpect {
+    enum : uint8_t { None = 0, Generation = 1 << 0, Code = 1 << 1 };
+    uint8_t mask = None;
+    uint32_t generation = 0;
+    WaybillCode code;
+
+    static CarItemExpect always() { return CarItemExpect(); }
+    static CarItemExpect onGeneration(uint32_t gen) { CarItemExpect e; e.mask = Generation; e.generation = gen; return e; }
+    static CarItemExpect onCode(const WaybillCode& c) { CarItemExpect e; e.mask = Code; e.code = c; return e; }
+};
 
 class CarItemsWriteThread {
 public:
@@ -19,19 +44,27 @@ public:
     CarItemsWriteThread(const CarItemsWriteThread&) = delete;
     CarItemsWriteThread& operator=(const CarItemsWriteThread&) = delete;
 
-    // 三个写接口
-    void writeSlotInfo(int carID, int port_num, int position, int offset, bool inside);
-    void writeItemInfo(int carID, std::string code);
-    void setRunNum(int carID, int runTurn_number);
-    void initCarItem(int carID);
-    void waitUntilIdle(); // 可选；用于测试/优雅停机
+    using Expect = CarItemExpect;
+
+    // 写接口, expect 缺省为无条件写入
+    void writeSlotInfo(int carID, int port_num, int position, int offset, bool inside, const Expect& expect = Expect());
+    void writeItemInfo(int carID, const WaybillCode& code, const Expect& expect = Expect());
+    void setRunNum(int carID, int runTurn_number, const Expect& expect = Expect());
+    void initCarItem(int carID, const Expect& expect = Expect());
+    uint64_t conflicts() const { return conflicts_.load(std::memory_order_relaxed); }     //因条件不满足被丢弃的写入数
+    void waitUntilIdle(); // 等待已提交的事件全部生效
     void log(const std::string& msg)
     {
         Logger::getInstance().Log(msg);
     }
     void startLoop();
+    // 无锁读取最近一次发布的小车信息快照, 读者不复制也不阻塞写线程
+    std::shared_ptr<const CarItemsSnapshot> snapshot() const { return snapshot_.load(); }
+    void setOnChanged(std::function<void()> cb) { onChanged_ = std::move(cb); }   //写入生效后回调, 用于唤醒下件调度
+    // 取走自上次调用以来被写入过的小车号; 置位发生在对应快照发布之后, 取到后读取的快照一定已包含这些写入
+    size_t takeDirty(std::vector<int>& carIDs) { return dirty_.take(carIDs); }
 private:
-    // 事件类型与结构体（无需 std::function）
+    // 事件类型与结构体(可平凡复制, 直接存放在环形队列槽位中)
     enum class EventType : uint8_t {
         WriteSlot,
         WriteItem,
@@ -41,18 +74,21 @@ private:
     struct Event {
         EventType type;
         int carID;
+        uint32_t seq = 0;           //该小车的提交序号, 由 submit 填写
+        Expect expect;              //生效条件
         int port_num = -1;
         int position = -1;
         int offset = -1;
         bool inside = false;
         bool isLoaded = false;
-        std::string code;
+        WaybillCode code;
         int runTurn_number = 0;
 
         // 构造器辅助
         static Event MakeWriteSlot(int carID_, int port_num_, int position_, int offset_, bool inside_) {
             Event e;
             e.type = EventType::WriteSlot;
+            e.carID = carID_;
             e.port_num = port_num_;
             e.position = position_;
             e.offset = offset_;
@@ -60,10 +96,11 @@ private:
             e.isLoaded = true;
             return e;
         }
-        static Event MakeWriteItem(int carID_, std::string code_) {
+        static Event MakeWriteItem(int carID_, const WaybillCode& code_) {
             Event e;
             e.type = EventType::WriteItem;
-            e.code = std::move(code_);
+            e.carID = carID_;
+            e.code = code_;
             e.runTurn_number = 0;
             e.isLoaded = true;
             return e;
@@ -71,12 +108,14 @@ private:
         static Event MakeSetRunNum(int carID_, int runTurn_number_) {
             Event e;
             e.type = EventType::SetRunNum;
+            e.carID = carID_;
             e.runTurn_number = runTurn_number_;
             return e;
         }
         static Event MakeInitItem(int carID_) {
             Event e;
             e.type = EventType::InitItem;
+            e.carID = carID_;
             //e.code = "";                 //面单号为空
             e.port_num = -1;             //格口号初始化
             e.position = -1;       // 初始时无下件目标，可设为 -1 表示无目标
@@ -88,16 +127,39 @@ private:
     };
 
 private:
+    static constexpr size_t RingCapacity = 4096;
+
     std::vector<CarItem>& carItems_;
     std::shared_mutex& carItemsLock_;
 
-    std::mutex qMutex_;
+    MpscRing<Event> ring_{ RingCapacity };
+    std::unique_ptr<std::atomic<uint32_t>[]> submitSeq_;   //下标 = 小车号, 各生产者领取的下一个序号
+    int maxCarID_ = 0;
+    std::vector<uint32_t> appliedSeq_;                      //写线程使用: 每辆小车下一个应生效的序号
+    std::vector<std::vector<Event>> pending_;               //写线程使用: 序号提前到达的事件, 等待前序事件
+    std::atomic<uint64_t> submitted_{ 0 };
+    std::atomic<uint64_t> applied_{ 0 };
+    std::atomic<uint64_t> ringFull_{ 0 };                  //队列满时生产者重试次数
+    std::vector<int> batchChanged_;                         //写线程使用: 本批次被写入的小车下标
+    std::vector<uint8_t> batchMark_;
+    std::vector<uint32_t> generation_;                      //写线程使用: 每辆小车的当前代数, 发布时复制到快照
+    std::atomic<uint64_t> conflicts_{ 0 };
+    DirtyCarSet dirty_;
+
+    std::mutex qMutex_;                 //只用于写线程空闲时的休眠/唤醒
     std::condition_variable qCv_;
-    std::queue<Event> q_;
+    std::atomic<bool> sleeping_{ false };
     std::atomic<bool> stopping_{ false };
     std::thread worker_;
+    std::function<void()> onChanged_;
+    PublishedSnapshot<CarItemsSnapshot> snapshot_;
 
+    void submit(Event ev, const Expect& expect);
+    void apply(const Event& ev);        // 持有写锁时调用
+    bool drainRing();                   // 持有写锁时调用, 返回是否有事件生效
     void workerLoop();
+    void notifyChanged() { if (onChanged_) onChanged_(); }
+    void publish();     // 持有写锁时调用, 发布新版本, 只重建本批次变化小车的调度字段
     int indexForCarID_nocheck(int carID);
 };
 
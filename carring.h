@@ -0,0 +1,39 @@
+#ifndef CARRING_H
+#define CARRING_H
+#include <atomic>
+
+// 环线小车位置模型: 只保存一个旋转偏移(经过的小车数), 位置按需计算
+// 小车位置 = (TotalCarNum - passingCarNum + carID) % TotalCarNum, 小车号从 1 开始
+class CarRing {
+public:
+    void reset(int totalCars)
+    {
+        total_ = totalCars;
+        passing_.store(0, std::memory_order_release);
+    }
+    void rotate(int passingCarNum) { passing_.store(passingCarNum, std::memory_order_release); }  //步进光电更新经过车数
+    int passing() const { return passing_.load(std::memory_order_acquire); }
+    int total() const { return total_; }
+
+    int positionOf(int carID) const { return positionOf(carID, passing()); }
+    int carAt(int position) const { return carAt(position, passing()); }
+
+    // 使用同一个 passing 值计算, 保证一次遍历中位置一致
+    int positionOf(int carID, int passing) const
+    {
+        if (total_ <= 0) return -1;
+        return ((total_ - passing + carID) % total_ + total_) % total_;
+    }
+    int carAt(int position, int passing) const     //位置 -> 小车号, O(1)
+    {
+        if (total_ <= 0) return -1;
+        int car = ((position + passing) % total_ + total_) % total_;
+        return car == 0 ? total_ : car;
+    }
+
+private:
+    int total_ = 0;
+    std::atomic<int> passing_{ 0 };
+};
+
+#endif // CARRING_H
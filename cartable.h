@@ -0,0 +1,65 @@
+#ifndef CARTABLE_H
+#define CARTABLE_H
+#include <cstdint>
+#include <vector>
+#include "StructInfo.h"
+
+// 结构数组(SoA)形式的小车调度字段, 由写线程随快照一起构建. 下标 = 小车号 - 1.
+// carLoop 只扫描这几列连续的 int32, 无分支, 编译器可向量化; 面单号等冷数据仍在 CarItem 中
+struct CarTable {
+    int total = 0;
+    std::vector<int32_t> target;    //目标格口位置, 未装货或无有效格口为 -1
+    std::vector<int32_t> offset;    //目标格口偏移量(ms)
+    std::vector<int32_t> port;      //目标格口号
+    std::vector<uint8_t> inside;    //目标格口是否在内圈
+
+    void build(const std::vector<CarItem>& items)
+    {
+        total = static_cast<int>(items.size());
+        target.assign(total, -1);
+        offset.assign(total, 0);
+        port.assign(total, -1);
+        inside.assign(total, 0);
+        for (int i = 0; i < total; ++i) setRow(i, items[i]);
+    }
+
+    void setRow(int i, const CarItem& item)     //只更新一辆小车, 写线程按变化的小车增量修改
+    {
+        if (!item.isLoaded || item.targetPosition < 0 || item.port_num < 1) {   //无下件目标
+            target[i] = -1;
+            offset[i] = 0;
+            port[i] = -1;
+            inside[i] = 0;
+            return;
+        }
+        target[i] = item.targetPosition;
+        offset[i] = item.offset;
+        port[i] = item.port_num;
+        inside[i] = item.inside ? 1 : 0;
+    }
+
+    // 当前经过车数下, 位置等于目标位置的小车(即到达目标格口), 小车号写入 carIDs
+    // 位置 = (total - passing + carID) % total, 用两次条件减法代替取模
+    void collectArrived(int passing, std::vector<int>& carIDs, std::vector<uint8_t>& mask) const
+    {
+        carIDs.clear();
+        if (total <= 0) return;
+        mask.resize(total);
+        const int32_t base = total - passing;
+        const int32_t* tgt = target.data();
+        uint8_t* m = mask.data();
+        for (int32_t i = 0; i < total; ++i)
+        {
+            int32_t pos = base + i + 1;
+            pos -= total & -static_cast<int32_t>(pos >= total);
+            pos -= total & -static_cast<int32_t>(pos >= total);
+            m[i] = static_cast<uint8_t>(pos == tgt[i]);
+        }
+        for (int32_t i = 0; i < total; ++i)
+        {
+            if (m[i]) carIDs.push_back(i + 1);
+        }
+    }
+};
+
+#endif // CARTABLE_H
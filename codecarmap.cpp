@@ -0,0 +1,78 @@
+#include "codecarmap.h"
+
+void CodeCarMap::put(const WaybillCode& code, int carID, clock::time_point now)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.map.find(code);
+    if (it == shard.map.end() && shard.map.size() >= maxPerShard_ && !shard.map.empty())
+    {
+        auto oldest = shard.map.begin();        //分片已满, 淘汰绑定最早的记录
+        for (auto jt = shard.map.begin(); jt != shard.map.end(); ++jt) {
+            if (jt->second.boundAt < oldest->second.boundAt) oldest = jt;
+        }
+        shard.map.erase(oldest);
+        overflowed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.map.insert_or_assign(code, Entry{ carID, now });
+}
+
+bool CodeCarMap::take(const WaybillCode& code, int& carID)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.map.find(code);
+    if (it == shard.map.end()) return false;
+    carID = it->second.carID;
+    shard.map.erase(it);
+    return true;
+}
+
+bool CodeCarMap::find(const WaybillCode& code, int& carID)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.map.find(code);
+    if (it == shard.map.end()) return false;
+    carID = it->second.carID;
+    return true;
+}
+
+size_t CodeCarMap::evictExpired(clock::time_point now)
+{
+    size_t removed = 0;
+    auto deadline = now - ttl();
+    for (auto& shard : shards_)         //逐个分片加锁, 不会同时阻塞所有分片
+    {
+        std::lock_guard<std::mutex> lk(shard.mtx);
+        for (auto it = shard.map.begin(); it != shard.map.end();)
+        {
+            if (it->second.boundAt < deadline) {
+                it = shard.map.erase(it);
+                ++removed;
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    expired_.fetch_add(removed, std::memory_order_relaxed);
+    return removed;
+}
+
+size_t CodeCarMap::size()
+{
+    size_t total = 0;
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lk(shard.mtx);
+        total += shard.map.size();
+    }
+    return total;
+}
+
+std::string CodeCarMap::summary()
+{
+    return "记录数: [" + std::to_string(size()) + "], 超时清除: [" + std::to_string(expired_.load(std::memory_order_relaxed))
+        + "], 溢出淘汰: [" + std::to_string(overflowed_.load(std::memory_order_relaxed)) + "]";
+}
@@ -0,0 +1,47 @@
+#ifndef CODECARMAP_H
+#define CODECARMAP_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "waybillcode.h"
+
+// 面单号 -> 小车号映射, 按面单号哈希分成若干分片, 每个分片独立加锁, 相机绑定与格口回传互不阻塞.
+// 每条记录带绑定时间, 超过 TTL 仍未收到格口的记录由 evictExpired 清除; 单个分片超过上限时淘汰最早的记录
+class CodeCarMap {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr size_t ShardCount = 16;
+
+    void setTtl(clock::duration ttl) { ttl_.store(ttl.count(), std::memory_order_relaxed); }
+    clock::duration ttl() const { return clock::duration(ttl_.load(std::memory_order_relaxed)); }
+    void setMaxPerShard(size_t maxEntries) { maxPerShard_ = maxEntries; }
+
+    void put(const WaybillCode& code, int carID, clock::time_point now = clock::now());
+    bool take(const WaybillCode& code, int& carID);       //查找并删除, 同一面单只会被取到一次
+    bool find(const WaybillCode& code, int& carID);
+    size_t evictExpired(clock::time_point now = clock::now());     //返回本次清除的数量
+    size_t size();
+    std::string summary();
+
+private:
+    struct Entry {
+        int carID;
+        clock::time_point boundAt;
+    };
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        std::unordered_map<WaybillCode, Entry> map;
+    };
+    Shard& shardFor(const WaybillCode& code) { return shards_[code.hash() % ShardCount]; }
+
+    std::array<Shard, ShardCount> shards_;
+    std::atomic<clock::rep> ttl_{ std::chrono::duration_cast<clock::duration>(std::chrono::minutes(10)).count() };
+    size_t maxPerShard_ = 1024;
+    std::atomic<uint64_t> expired_{ 0 };
+    std::atomic<uint64_t> overflowed_{ 0 };
+};
+
+#endif // CODECARMAP_H
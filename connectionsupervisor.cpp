@@ -0,0 +1,122 @@
+#include "connectionsupervisor.h"
+#include <algorithm>
+
+ConnectionSupervisor::~ConnectionSupervisor()
+{
+    stop();
+}
+
+void ConnectionSupervisor::addLink(const std::string& name, IsUpFn isUp, ReconnectFn reconnect, ReconnectedFn onReconnected)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (running_) {         //守护线程重连时不持锁, 启动后不再修改链路表
+        log("---- [连接守护] 已启动, 拒绝新增链路: [" + name + "]");
+        return;
+    }
+    Link link;
+    link.name = name;
+    link.isUp = std::move(isUp);
+    link.reconnect = std::move(reconnect);
+    link.onReconnected = std::move(onReconnected);
+    link.created = clock::now();
+    link.up = link.isUp();
+    link.upSince = link.created;
+    link.nextAttempt = link.created;
+    links_.push_back(std::move(link));
+}
+
+void ConnectionSupervisor::start()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (running_) return;
+    running_ = true;
+    worker_ = std::thread(&ConnectionSupervisor::loop, this);
+    log("---- [连接守护] 启动, 守护链路数: [" + std::to_string(links_.size()) + "]");
+}
+
+void ConnectionSupervisor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+ConnectionSupervisor::clock::duration ConnectionSupervisor::backoff(int failures)
+{
+    auto delay = BackoffBase * (1LL << std::min(failures, 10));
+    if (delay > BackoffMax) delay = BackoffMax;
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);      //抖动, 避免所有链路同时重连
+    return std::chrono::duration_cast<clock::duration>(delay * jitter(rng_));
+}
+
+void ConnectionSupervisor::loop()
+{
+    auto lastSummary = clock::now();
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (running_)
+    {
+        cv_.wait_for(lk, CheckInterval, [this] { return !running_; });
+        if (!running_) break;
+        auto now = clock::now();
+        for (auto& link : links_)
+        {
+            bool upNow = link.isUp();
+            if (link.up && !upNow) {            //刚断开
+                link.up = false;
+                link.upTotal += now - link.upSince;
+                link.failures = 0;
+                link.nextAttempt = now;
+                log("---- [连接守护] [" + link.name + "] 连接断开, 开始重连");
+            }
+            if (link.up || now < link.nextAttempt) continue;
+
+            lk.unlock();                        //重连可能阻塞, 不持有锁
+            bool ok = false;
+            try {
+                ok = link.reconnect();
+            }
+            catch (const std::exception& e) {
+                log("---- [连接守护] [" + link.name + "] 重连异常: " + e.what());
+            }
+            lk.lock();
+            now = clock::now();
+            if (ok) {
+                link.up = true;
+                link.upSince = now;
+                link.failures = 0;
+                ++link.reconnects;
+                log("---- [连接守护] [" + link.name + "] 重连成功, 第 [" + std::to_string(link.reconnects) + "] 次");
+                if (link.onReconnected) link.onReconnected();
+            }
+            else {
+                auto delay = backoff(link.failures++);
+                link.nextAttempt = now + delay;
+                log("---- [连接守护] [" + link.name + "] 重连失败, [" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(delay).count()) + "]ms 后重试");
+            }
+        }
+        if (now - lastSummary >= SummaryInterval) {
+            lastSummary = now;
+            lk.unlock();
+            log("---- [连接守护] 链路在线统计: " + summary());
+            lk.lock();
+        }
+    }
+}
+
+std::string ConnectionSupervisor::summary()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto now = clock::now();
+    std::string text;
+    for (const auto& link : links_)
+    {
+        auto up = link.upTotal + (link.up ? now - link.upSince : clock::duration(0));
+        auto total = now - link.created;
+        int percent = total.count() > 0 ? static_cast<int>(100.0 * up.count() / total.count()) : 100;
+        text += "[" + link.name + ": " + (link.up ? "在线" : "断开") + ", 在线率 " + std::to_string(percent) + "%, 重连 " + std::to_string(link.reconnects) + " 次] ";
+    }
+    return text;
+}
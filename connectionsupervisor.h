@@ -0,0 +1,67 @@
+#ifndef CONNECTIONSUPERVISOR_H
+#define CONNECTIONSUPERVISOR_H
+#include <string>
+#include <list>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <random>
+#include "logger.h"
+
+// 连接守护: 定时检查每条 TCP 链路, 断开后按带抖动的指数退避重连,
+// 重连成功后回调(用于重新同步计数), 并统计每条链路的在线时长
+class ConnectionSupervisor {
+public:
+    using clock = std::chrono::steady_clock;
+    using IsUpFn = std::function<bool()>;
+    using ReconnectFn = std::function<bool()>;
+    using ReconnectedFn = std::function<void()>;
+
+    ConnectionSupervisor() = default;
+    ~ConnectionSupervisor();
+    ConnectionSupervisor(const ConnectionSupervisor&) = delete;
+    ConnectionSupervisor& operator=(const ConnectionSupervisor&) = delete;
+
+    void addLink(const std::string& name, IsUpFn isUp, ReconnectFn reconnect, ReconnectedFn onReconnected = nullptr);    //只能在 start 之前调用
+    void start();
+    void stop();
+    std::string summary();      //各链路在线时长与重连次数
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    struct Link {
+        std::string name;
+        IsUpFn isUp;
+        ReconnectFn reconnect;
+        ReconnectedFn onReconnected;
+        bool up = false;
+        clock::time_point upSince;
+        clock::duration upTotal{ 0 };
+        clock::time_point created;
+        clock::time_point nextAttempt;
+        int failures = 0;           //连续重连失败次数, 决定退避时间
+        int reconnects = 0;
+    };
+
+    void loop();
+    clock::duration backoff(int failures);
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::list<Link> links_;      // start 之后只由守护线程读写, addLink 在启动后被拒绝
+    bool running_ = false;
+    std::thread worker_;
+    std::mt19937 rng_{ std::random_device{}() };
+
+    static constexpr std::chrono::milliseconds CheckInterval{ 200 };
+    static constexpr std::chrono::milliseconds BackoffBase{ 500 };
+    static constexpr std::chrono::milliseconds BackoffMax{ 30000 };
+    static constexpr std::chrono::seconds SummaryInterval{ 300 };
+};
+
+#endif // CONNECTIONSUPERVISOR_H
@@ -7,7 +7,9 @@
 #include <QJsonDocument>
 #include <QtConcurrent/QtConcurrent>
 #include <sstream>
+#include <cstring>
 #include "sqlconnectionpool.h"
+#include "socketreactor.h"
 extern std::tuple<std::string, std::string, int, int> splitUdpMessage(const std::string& msg, int num);
 extern std::string currentDateTimeString();
 extern std::string getCurrentTime();
@@ -25,8 +27,6 @@ DataProcessMain::DataProcessMain(QObject* parent)
         // 可视情况决定是否返回/退出
     }
 #endif
-    _camera41_rev_port = 2015;
-    _camera42_rev_port = 2012;
 }
 DataProcessMain::~DataProcessMain()
 {
@@ -42,6 +42,8 @@ void DataProcessMain::init()
         dbInit();
         initCameras();
         _loopDevice.init();
+        registerCameraLinks();
+        _loopDevice.linkSupervisor().start();       //所有链路注册完成后再启动守护线程
     }
     catch (const std::exception& e)
     {
@@ -52,9 +54,11 @@ void DataProcessMain::cleanup()
 {
     try
     {
-        _cameraClient41.disconnect();
-        _cameraClient42.disconnect();
+        _loopDevice.linkSupervisor().stop();     //先停止重连, 再断开相机
+        for (auto& station : _stations) station->stop();
+        m_threadPool.waitForDone(3000);         //等待已提交的入库任务完成
         _loopDevice.cleanup();
+        SocketReactor::instance().stop();
         WSACleanup();
     }
     catch (const std::exception& e)
@@ -66,29 +70,35 @@ void DataProcessMain::initCameras()
 {
     try
     {
-        if (camera41_ip == "" || camera42_ip == "" || _camera41_rev_port == 0 || _camera42_rev_port == 0)
+        _stations.clear();
+        for (size_t i = 0; i < _stationConfigs.size(); ++i)
         {
-            WriteLog("---- [相机初始化] 配置参数异常, 按照默认设置配置");
-            camera41_ip = "192.168.93.41";
-            camera42_ip = "192.168.93.42";
-            _camera41_rev_port = 2015;
-            _camera42_rev_port = 2012;
+            auto station = std::make_unique<ScannerStation>(static_cast<int>(i), _stationConfigs[i], camera_frame_delimiter);
+            station->start([this](ScannerStation& st, const ScannerStation::Frame& frame) { onScan(st, frame); });
+            station->connect();
+            _stations.push_back(std::move(station));
+            Sleep(20);
         }
-
-        if (_cameraClient41.connectTo(camera41_ip, _camera41_rev_port))	WriteLog("---- [41相机] 接收端口连接成功!");
-        else    WriteLog("---- [41相机] 接收端口连接失败!");
-        Sleep(20);
-        if (_cameraClient42.connectTo(camera42_ip, _camera42_rev_port))	WriteLog("---- [42相机] 接收端口连接成功!");
-        else    WriteLog("---- [42相机] 接收端口连接失败!");
-        Sleep(20);
-        connect(&_cameraClient41.client, &SocketClient::dataReceived, this, &DataProcessMain::on41cameraDataReceived);
-        connect(&_cameraClient42.client, &SocketClient::dataReceived, this, &DataProcessMain::on42cameraDataReceived);
+        if (_stations.empty()) WriteLog("---- [相机初始化] 未配置扫码站!");
     }
     catch (const std::exception& e)
     {
         WriteLog("---- [相机初始化] 异常 : " + std::string(e.what()));
     }
 }
+void DataProcessMain::registerCameraLinks()
+{
+    //相机重连后, 断线期间的触发不会再有回传, 从下一次触发开始匹配
+    auto& supervisor = _loopDevice.linkSupervisor();
+    for (auto& station : _stations)
+    {
+        ScannerStation* st = station.get();
+        supervisor.addLink(st->name(),
+            [st]() { return st->connection().client.SocketConnection.load(); },
+            [st]() { return st->connection().reconnect(); },
+            [this, st]() { _loopDevice.stationTriggers(st->index()).resync("重连"); });
+    }
+}
 void DataProcessMain::driveByCarid(int car_id)
 {
     try
@@ -100,116 +110,120 @@ void DataProcessMain::driveByCarid(int car_id)
         WriteLog("---- [driveByCarid] Exception : " + std::string(e.what()));
     }
 }
-void DataProcessMain::on41cameraDataReceived(const QByteArray& data)	//(SF6093319807519)
+void DataProcessMain::onScan(ScannerStation& station, const ScannerStation::Frame& frame)	//(SF6093319807519)
 {
+    const std::string tag = "---- [" + station.name() + "回传] ";
     try
     {
-        _camera41Count += 1;
-        std::string dataStr = data.toStdString();
-        std::stringstream ss(dataStr);
-        std::string item;
-        std::vector<std::string> parts;
-        std::string code = "";
-        while (std::getline(ss, item, ','))
-        {
-            parts.push_back(item);
-            //WriteLog("---- test  split: " + item);
-        }
-        if (parts.size() >= 2)
-        {
-            code = parts[1];
+        auto match = _loopDevice.stationTriggers(station.index()).match(frame.readAt);     //每一帧回传(含 NoRead)对应一次触发
+        WaybillCode code;
+        int frameCarID = 0;
+        auto parsed = station.parser().parse(frame.data.data(), frame.data.size(), code, &frameCarID);
+        if (parsed == WaybillParser::Result::TooLong) {
+            WriteLog(tag + "面单号超长: [" + frame.data + "]");
+            return;
         }
-        if (code == "NoRead" || code == "")
+        if (parsed == WaybillParser::Result::NoRead)
         {
-            //WriteLog("---- [41相机回传] 无效数据:[" + code + "]");
+            //WriteLog(tag + "无效数据:[" + frame.data + "]");
             return;
         }
-
-        auto [dev_camera41Count,car_id]  = _loopDevice.carToCamera41();
-        if(dev_camera41Count!=_camera41Count){                          //这次计数与光电触发的计数不一致,忽略这次的单号回传!会绑错小车号!
-            _loopDevice.updateCamera41Count(_camera41Count);
-            return;
+        int car_id = 0;
+        if (station.parser().hasCarField() && frameCarID >= 1 && frameCarID <= _loopDevice.totalCars()) {
+            car_id = frameCarID;                    //相机回传了下发的小车号, 以回传为准
+            if (match.by != CameraTriggerRing::MatchBy::None && match.trigger.carID != car_id)
+                WriteLog(tag + "面单号:[" + code + "] 回传小车号 [" + std::to_string(car_id) + "] 与触发匹配 [" + std::to_string(match.trigger.carID) + "] 不一致, 以回传为准");
         }
-        WriteLog("---- [41相机回传] 面单号:[" + code + "], 小车号: [" + std::to_string(car_id) + "]");
-        int slot_id = insertSupply_data(code, car_id);	//判断单号是否插入过数据库或请求过
-        if (slot_id == -1)	//未插入过数据库, 未进行请求
-        {
-            WriteLog("---- [物件数据] 单号:[" + code + "] 入库, 请求格口号.");
-            QMetaObject::invokeMethod(&_requestAPI,
-                                      "requestForSlot",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QString, QString::fromStdString(code)));
-            _loopDevice.updateCodeToCarMap(code, car_id);	//更新面单对应的小车
+        else {
+            if (match.by == CameraTriggerRing::MatchBy::None) {
+                WriteLog(tag + "面单号:[" + code + "] 未匹配到触发, 无法确定小车!");
+                return;
+            }
+            if (!match.trigger.synced) {                //触发时头车/步进未同步, 小车号不可信, 会绑错小车号!
+                WriteLog(tag + "面单号:[" + code + "] 触发时头车未同步, 不绑定!");
+                return;
+            }
+            car_id = match.trigger.carID;
         }
-        else if (slot_id == -10)	//已插入过数据库, 未请求到格口
+        WriteLog(tag + "面单号:[" + code + "], 小车号: [" + std::to_string(car_id) + "]");
+        _loopDevice.updateCodeToCarMap(code, car_id);	//先绑定面单与小车, 格口无论从数据库还是接口返回都按面单找到小车
+        std::string scanTime = getCurrentTime();
+        WaybillCache::Entry cached;
+        if (_waybillCache.touch(code, car_id, scanTime, cached))     //重复扫码(多圈), 格口直接从缓存决定, 数据库只做后台更新
         {
-            QMetaObject::invokeMethod(&_requestAPI,
-                                      "requestForSlot",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QString, QString::fromStdString(code)));
-            _loopDevice.updateCodeToCarMap(code, car_id);
+            applySlotDecision(code, cached.slotID);
+            submitIngest([this, code, car_id, scanTime]() { updateScanRecord(code, car_id, scanTime); });
         }
         else
         {
-            WriteLog("---- [物件数据] 单号:[" + code + "] 已请求, 格口号:[" + std::to_string(slot_id) + "], 更新小车列表..");
-            _loopDevice.updateCodeToCarMap(code, car_id);	//更新面单对应的小车
-            _loopDevice.updateSlotByCarID(car_id, slot_id);
+            submitIngest([this, code, car_id]() { persistScan(code, car_id); });    //入库与格口请求交给后台线程, 不阻塞扫码站处理线程
         }
-
+        if (_scanCount.fetch_add(1, std::memory_order_relaxed) % 1000 == 999)
+            WriteLog("---- [面单缓存] " + _waybillCache.summary());
     }
     catch (const std::exception& ex)
     {
-        WriteLog(std::string("---- [41相机回传] 处理异常: ") + ex.what());
+        WriteLog(tag + "处理异常: " + ex.what());
     }
 }
-
-void DataProcessMain::on42cameraDataReceived(const QByteArray& data)
+void DataProcessMain::submitIngest(std::function<void()> task)
+{
+    int pending = _ingestPending.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (pending > 0 && pending % 100 == 0)
+        WriteLog("---- [入库队列] 积压: [" + std::to_string(pending) + "], 数据库处理跟不上扫码!");
+    m_threadPool.start([this, task = std::move(task)]() {
+        task();
+        _ingestPending.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+void DataProcessMain::applySlotDecision(const WaybillCode& code, int slot_id)
+{
+    if (slot_id < 1)	//未请求到格口
+    {
+        QMetaObject::invokeMethod(&_requestAPI,
+                                  "requestForSlot",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, QString::fromUtf8(code.data(), static_cast<int>(code.size()))));
+        return;
+    }
+    WriteLog("---- [物件数据] 单号:[" + code + "] 已请求, 格口号:[" + std::to_string(slot_id) + "], 更新小车列表..");
+    _loopDevice.updateSlotByCode(code, slot_id);    //按面单更新: 期间小车若已改绑其他面单则不会写错
+}
+void DataProcessMain::persistScan(const WaybillCode& code, int car_id)
 {
     try
     {
-        _camera42Count += 1;                                            //先加1, 设备中的光电触发也先加1
-        std::string dataStr = data.toStdString();
-        if (dataStr == "NoRead")
-        {
-            //WriteLog("---- [42相机回传] 无效数据:[" + dataStr + "]");
-            return;
-        }
-        auto [dev_camera42Count,car_id]  = _loopDevice.carToCamera42();
-        if(dev_camera42Count!=_camera42Count){                          //这次计数与光电触发的计数不一致,忽略这次的单号回传!会绑错小车号!
-            WriteLog("---- [42相机回传] 计数不一致! 忽略本次回传!");
-            _loopDevice.updateCamera42Count(_camera42Count);
+        int slot_id = insertSupply_data(code.str(), car_id);	//判断单号是否插入过数据库或请求过
+        if (slot_id == -1) WriteLog("---- [物件数据] 单号:[" + code + "] 入库, 请求格口号.");
+        WaybillCache::Entry entry;
+        entry.slotID = slot_id > 0 ? slot_id : -1;
+        entry.carID = car_id;
+        entry.scanTime = getCurrentTime();
+        entry = _waybillCache.merge(code, entry);      //先写缓存再请求格口, 格口回传总能命中这条记录; 已回传的格口不会被覆盖
+        applySlotDecision(code, entry.slotID);
+    }
+    catch (const std::exception& ex)
+    {
+        WriteLog("---- [物件数据] 单号:[" + code + "] 入库异常: " + ex.what());
+    }
+}
+void DataProcessMain::updateScanRecord(const WaybillCode& code, int car_id, const std::string& scanTime)
+{
+    try
+    {
+        auto _sqlQuery = SqlConnectionPool::instance().acquire();
+        if(!_sqlQuery){
+            Logger::getInstance().Log("----[sql异常] 连接空指针!");
             return;
         }
-
-        WriteLog("---- [42相机回传] 面单号:[" + dataStr + "], 小车号: [" + std::to_string(car_id) + "]");
-        int slot_id = insertSupply_data(dataStr, car_id);	//判断单号是否插入过数据库或请求过
-        if (slot_id == -1)	//未插入过数据库, 未进行请求
-        {
-            WriteLog("---- [物件数据] 单号:[" + dataStr + "] 入库, 请求格口号.");
-            QMetaObject::invokeMethod(&_requestAPI,
-                                      "requestForSlot",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QString, QString::fromStdString(dataStr)));
-            _loopDevice.updateCodeToCarMap(dataStr, car_id);	//更新面单对应的小车
-        }
-        else if (slot_id == -10)	//已插入过数据库, 未请求到格口
-        {
-            QMetaObject::invokeMethod(&_requestAPI,
-                                      "requestForSlot",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QString, QString::fromStdString(dataStr)));
-            _loopDevice.updateCodeToCarMap(dataStr, car_id);
-        }
-        else
-        {
-            WriteLog("---- [物件数据] 单号:[" + dataStr + "] 已请求, 格口号:[" + std::to_string(slot_id) + "], 更新小车列表..");
-            _loopDevice.updateCodeToCarMap(dataStr, car_id);	//更新面单对应的小车
-            _loopDevice.updateSlotByCarID(car_id, slot_id);
-        }
+        //不写 slot_id: 格口只由格口回传写入, 避免与回传的更新交错时被覆盖
+        const std::vector<std::string> columns = { "code","weight","scan_time","car_id" };
+        const std::vector<std::string> values = { code.str(), "1", scanTime, std::to_string(car_id) };
+        _sqlQuery->updateRow("supply_data", columns, values, "code", code.str(), false);
     }
-    catch (const std::exception& ex)
+    catch (const std::exception& e)
     {
-        WriteLog(std::string("---- [42相机回传] 处理异常: ") + ex.what());
+        WriteLog("---- [update supplyData] Exception : " + std::string(e.what()));
     }
 }
 void DataProcessMain::onSlotReceive(const QString& code, int slot_id)
@@ -219,6 +233,7 @@ void DataProcessMain::onSlotReceive(const QString& code, int slot_id)
         int copy_slot_id = slot_id;
         std::string copy_code = code.toStdString();
         WriteLog("---- [请求回传] 单号:[" + copy_code + "], 格口号:[" + std::to_string(copy_slot_id) + "]");
+        if (WaybillCode::fits(copy_code.size())) _waybillCache.setSlot(WaybillCode(copy_code), copy_slot_id);
         QtConcurrent::run([copy_code, copy_slot_id]() {
             auto _sqlQuery = SqlConnectionPool::instance().acquire();
             if(!_sqlQuery){
@@ -246,7 +261,8 @@ void DataProcessMain::onSlotReceive(const QString& code, int slot_id)
 }
 void DataProcessMain::handleUpdateSlotOnMainThread(const std::string& code, int slot_id)
 {
-    _loopDevice.updateSlotByCode(code, slot_id);
+    if (!WaybillCode::fits(code.size())) return;        //超长面单号不会绑定小车
+    _loopDevice.updateSlotByCode(WaybillCode(code), slot_id);
 }
 void DataProcessMain::dbInit()
 {
@@ -257,25 +273,13 @@ void DataProcessMain::dbInit()
             Logger::getInstance().Log("----[sql异常] 连接空指针!");
             return;
         }
-        auto db_camera41_ip = _sqlQuery->queryString("config", "name", "camera_ip_one", "value");
-        if (db_camera41_ip)	camera41_ip = *db_camera41_ip;
-
-        auto db_camera42_ip = _sqlQuery->queryString("config", "name", "camera_ip_two", "value");
-        if (db_camera42_ip)	camera42_ip = *db_camera42_ip;
-
-        auto db_camera41_port = _sqlQuery->queryString("config", "name", "camera_receive_one", "value");
-        if (db_camera41_port)	_camera41_rev_port = std::stoi(*db_camera41_port);
-        else
-        {
-            _camera41_rev_port = 0;
-        }
+        _stationConfigs = ScannerStationConfig::load();     //扫码站配置表, 未配置时沿用 41/42 相机配置项
+        _loopDevice.setScannerStations(_stationConfigs);
 
-        auto db_camera42_port = _sqlQuery->queryString("config", "name", "camera_receive_two", "value");
-        if (db_camera42_port)	_camera42_rev_port = std::stoi(*db_camera42_port);
-        else
-        {
-            _camera42_rev_port = 0;
-        }
+        auto db_camera_delimiter = _sqlQuery->queryString("config", "name", "camera_frame_delimiter", "value");     //相机帧结尾分隔符, 未配置则按单次接收分帧
+        if (db_camera_delimiter)	camera_frame_delimiter = MessageFramer::parseDelimiter(*db_camera_delimiter);
+        auto db_cache_size = _sqlQuery->queryString("config", "name", "waybill_cache_size", "value");     //面单缓存容量(条), 默认 16384
+        if (db_cache_size && std::stoi(*db_cache_size) > 0)	_waybillCache.setCapacity(std::stoi(*db_cache_size));
     }
     catch (const std::exception& e)
     {
@@ -354,7 +358,14 @@ void DataProcessMain::resetSlotConfigurations()
 }
 void DataProcessMain::testCamera()
 {
-    _loopDevice.testCamera();
+    try
+    {
+        for (auto& station : _stations) station->connection().send("1");      //触发各扫码站相机
+    }
+    catch (const std::exception& e)
+    {
+        WriteLog("---- [测试相机] 异常: " + std::string(e.what()));
+    }
 }
 void DataProcessMain::resetDriver()
 {
@@ -9,6 +9,8 @@
 #include "devicemanager.h"
 #include <QThreadPool>
 #include "requestapi.h"
+#include "waybillcache.h"
+#include <functional>
 
 class DataProcessMain : public QObject
 {
@@ -28,7 +30,8 @@ public:
     void driveByCarid(int car_id);
     void startTestCarLoop();
     void stopTestCarLoop();
-    void initCameras();
+    void initCameras();             //按扫码站配置连接相机并启动各站处理线程
+    void registerCameraLinks();     //相机连接交给连接守护断线重连
     void lockCar(int car_id);
     void unlockCar(int car_id);
     void cleanup();
@@ -41,20 +44,23 @@ private:
     RequestAPI _requestAPI;     //设置两个请求类
     // RequestAPI _requestAPISecond;
 
-    //程序作为客户端
-    SocketConnection _cameraClient41;	//ip为 41相机
-    SocketConnection _cameraClient42;	//ip为 42相机
-
-    std::string camera41_ip = "";
-    std::string camera42_ip = "";
-    int _camera41_rev_port, _camera42_rev_port;
-    uint64_t _camera41Count = 0;
-    uint64_t _camera42Count = 0;
+    //程序作为客户端, 每个扫码站一个相机连接
+    std::vector<ScannerStationConfig> _stationConfigs;
+    std::vector<std::unique_ptr<ScannerStation>> _stations;
+    char camera_frame_delimiter = '\0';     //相机帧结尾分隔符, '\0' = 单次接收即一帧
+    // 相机回传处理, 在该扫码站的处理线程中调用; 每一帧(含 NoRead)对应一次触发
+    void onScan(ScannerStation& station, const ScannerStation::Frame& frame);
+    // 入库阶段: 在 m_threadPool 中写 supply_data; 缓存未命中时由入库结果决定请求格口或直接按已有格口更新小车
+    void submitIngest(std::function<void()> task);
+    void applySlotDecision(const WaybillCode& code, int slot_id);
+    void persistScan(const WaybillCode& code, int car_id);
+    void updateScanRecord(const WaybillCode& code, int car_id, const std::string& scanTime);    //缓存命中后的后台写入
+    std::atomic<int> _ingestPending{ 0 };      //已提交未完成的入库任务数
+    WaybillCache _waybillCache;                 //supply_data 的内存缓存, 重复扫码不再查库
+    std::atomic<uint64_t> _scanCount{ 0 };
 private slots:
     void onSlotReceive(const QString& code, int slot_id);
     // void onSlotReceiveSecond(const QString& code, int slot_id);
-    void on41cameraDataReceived(const QByteArray& data);
-    void on42cameraDataReceived(const QByteArray& data);
 public slots:
     void resetCamerasPosition();
     void resetSlotConfigurations();
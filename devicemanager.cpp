@@ -5,16 +5,17 @@
 #include <QMetaObject>    // QMetaObject::invokeMethod
 #include "sqlconnectionpool.h"
 #include "steplogger.h"
+#include "socketreactor.h"
 #include <sstream>
+#include <cstdio>
 
 DeviceManager::DeviceManager()
 {
     TotalCarNum = 202;
     TotalPortNum = 252;
-    camera41_send_port = 0;
-    camera42_send_port = 0;
-    _currentCarIdFor41.store(1,std::memory_order_release);
-    _currentCarIdFor42.store(1,std::memory_order_release);
+    carRing.reset(TotalCarNum);
+    headSync.setTotalCars(TotalCarNum);
+    carFlags.resize(TotalCarNum);
 }
 void DeviceManager::init()
 {
@@ -22,13 +23,17 @@ void DeviceManager::init()
     {
         dbInit();
         carItemsWriter.reset(new CarItemsWriteThread(carItems, carItemsLock));
+        carItemsWriter->setOnChanged([this]() {
+            unloadScheduler.notify();       //新快照已发布, carloop 需要重新计算下件时间
+        });
         carItemsWriter->startLoop();
         Sleep(20);
+        initPhotoFramers();
+        buildCarIdFrames();
         tcpConnection();
-        connect(&_stepTcp.client, &SocketClient::dataReceived, this, &DeviceManager::stepReceive);      //步进光电
-        connect(&_headTcp.client, &SocketClient::dataReceived, this, &DeviceManager::headReceive);      //头车光电
-        connect(&_emptyTcp.client, &SocketClient::dataReceived, this, &DeviceManager::emptyReceive);    //空车光电
+        connectCarIdLinks();
         serialPortInit();
+        registerLinks();            //连接守护由调用方在相机等链路全部注册后启动
         startLoop();
     }
     catch (const std::exception& e)
@@ -54,46 +59,45 @@ void DeviceManager::dbInit()
         if (car_num)
         {
             TotalCarNum = std::stoi(*car_num);
-            carStatus.resize(TotalCarNum);
+            carRing.reset(TotalCarNum);     //初始化小车位置, 经过车数为0
+            headSync.setTotalCars(TotalCarNum);
             carItems.resize(TotalCarNum);
-            carLocks.resize(TotalCarNum);
+            carFlags.resize(TotalCarNum);
             for (int i = 1; i <= TotalCarNum; ++i)
             {
-                initCarPosition(i, i);//初始化小车位置, 小车号就是当前位置, 内部加锁
                 initCarItems(i);//初始化小车上信息
             }
         }
-        auto position41 = _sqlQuery->queryString("config", "name", "camera_position_one", "value");
-        if (position41)
+        auto match_window = _sqlQuery->queryString("config", "name", "camera_match_window_ms", "value");    //相机回传按时间匹配触发的容差
+        if (match_window && std::stoi(*match_window) > 0)
         {
-            _camera41Position = std::stoi(*position41);
+            for (auto& station : _stations) station->triggers.setWindowMs(std::stoi(*match_window));
         }
-        auto position42 = _sqlQuery->queryString("config", "name", "camera_position_two", "value");
-        if (position42)
+        auto camera_latency = _sqlQuery->queryString("config", "name", "camera_latency_ms", "value");      //相机触发到回传的预期延时, 用于启动/重连后的第一帧
+        if (camera_latency && std::stoi(*camera_latency) > 0)
         {
-            _camera42Position = std::stoi(*position42);
+            for (auto& station : _stations) station->triggers.setExpectedLatencyMs(std::stoi(*camera_latency));
         }
-        auto camera41_port = _sqlQuery->queryString("config", "name", "camera_send_one", "value");
-        if (camera41_port)
+        auto camera_latency_max = _sqlQuery->queryString("config", "name", "camera_latency_max_ms", "value");  //未配置预期延时时, 第一帧允许的最大延时
+        if (camera_latency_max && std::stoi(*camera_latency_max) > 0)
         {
-            camera41_send_port = std::stoi(*camera41_port);
+            for (auto& station : _stations) station->triggers.setMaxLatencyMs(std::stoi(*camera_latency_max));
         }
-        auto camera42_port = _sqlQuery->queryString("config", "name", "camera_send_two", "value");
-        if(camera42_port)
+        auto code_map_ttl = _sqlQuery->queryString("config", "name", "code_map_ttl_s", "value");    //面单绑定后等待格口的最长时间(秒)
+        if (code_map_ttl && std::stoi(*code_map_ttl) > 0)
         {
-            camera42_send_port = std::stoi(*camera42_port);
+            codeToCarMap.setTtl(std::chrono::seconds(std::stoi(*code_map_ttl)));
+        }
+        auto photo_frame = _sqlQuery->queryString("config", "name", "photo_frame_bytes", "value");    //光电定长帧字节数, 未配置则按单次接收分帧
+        if (photo_frame)
+        {
+            photo_frame_bytes = std::stoi(*photo_frame);
         }
-        auto db_camera41_ip = _sqlQuery->queryString("config", "name", "camera_ip_one", "value");
-        if (db_camera41_ip)	camera41_ip = *db_camera41_ip;
-
-        auto db_camera42_ip = _sqlQuery->queryString("config", "name", "camera_ip_two", "value");
-        if (db_camera42_ip)	camera42_ip = *db_camera42_ip;
-
         auto slot_config = _sqlQuery->readTable("outport_config");
         if (!slot_config.empty())
         {
-            //TotalPortNum = slot_config.size();
-            TotalPortNum = 252;
+            int max_port_id = 0;
+            auto ports = std::make_shared<PortTable>();
             for (const auto& row : slot_config)
             {
                 if (row.size() < 4)continue;
@@ -101,9 +105,14 @@ void DeviceManager::dbInit()
                 int position = std::stoi(row[1]);
                 int offset = std::stoi(row[2]);
                 bool inside = (row[3] == "1");
-                outports_map[port_id] = { port_id, position, offset, inside };
+                (*ports)[port_id] = { port_id, position, offset, inside };
                 slots_status_map[port_id] = false;//初始化格口状态, 0 = 正常, 1 = 锁格
+                max_port_id = std::max(max_port_id, port_id);
             }
+            if (max_port_id > 0) TotalPortNum = max_port_id;    //格口数量按配置表, 不再固定 252
+            log("---- [初始化] 格口数量: [" + std::to_string(TotalPortNum) + "]");
+            std::lock_guard<std::mutex> lk(portTableWriteLock);
+            portTable.publish(std::move(ports));
         }
         auto strong_slot_config = _sqlQuery->queryString("config", "name", "strong_slot", "value");
         if (strong_slot_config)
@@ -119,19 +128,10 @@ void DeviceManager::dbInit()
         if (car_acceleration_first) _car_acceleration_first.store(std::stoi(*car_acceleration_first));
         log("---- [初始化] 运行速度:[" + std::to_string(_car_speed_first.load()) + "], 运行距离:[" + std::to_string(_car_distance_first.load()) + "], 运行加速度:[" + std::to_string(_car_acceleration_first) + "]");
 
-        auto db_camera41_sendcarid_ip = _sqlQuery->queryString("config","name","camera_carid_ip_one","value");
-        if(db_camera41_sendcarid_ip) camera41_carid_ip = *db_camera41_sendcarid_ip;
-        auto db_camera41_sendcarid_port = _sqlQuery->queryString("config","name","camera_carid_port_one","value");
-        if(db_camera41_sendcarid_port) camera41_send_carid_port = std::stoi(*db_camera41_sendcarid_port);
-
-        auto db_camera42_sendcarid_ip = _sqlQuery->queryString("config","name","camera_carid_ip_two","value");
-        if(db_camera42_sendcarid_ip) camera42_carid_ip = *db_camera42_sendcarid_ip;
-        auto db_camera42_sendcarid_port = _sqlQuery->queryString("config","name","camera_carid_port_two","value");
-        if(db_camera42_sendcarid_port) camera42_send_carid_port = std::stoi(*db_camera42_sendcarid_port);
-
         auto head_signal_offset = _sqlQuery->queryString("config","name","head_signal_offset","value");
         if(head_signal_offset){
             m_head_signal_offset = std::stoi(*head_signal_offset);
+            headSync.setToleranceMs(m_head_signal_offset);
             log("---- [初始化] 与头车时间差为: ["+*head_signal_offset+"]");
         }
         auto one_car_time = _sqlQuery->queryString("config","name","one_car_time","value");
@@ -139,6 +139,13 @@ void DeviceManager::dbInit()
             oneCarTime = std::stoi(*one_car_time);
             log("---- [初始化] 单车时间: ["+*one_car_time+"]");
         }
+        auto ack_timeout = _sqlQuery->queryString("config","name","drive_ack_timeout","value");
+        if(ack_timeout) drive_ack_timeout_ms = std::stoi(*ack_timeout);
+        auto max_resend = _sqlQuery->queryString("config","name","drive_max_resend","value");
+        if(max_resend) drive_max_resend = std::stoi(*max_resend);
+        auto failover_lost = _sqlQuery->queryString("config","name","drive_failover_lost","value");
+        if(failover_lost) drive_failover_lost = std::stoi(*failover_lost);
+        log("---- [初始化] 回码超时: [" + std::to_string(drive_ack_timeout_ms) + "]ms, 最大重发次数: [" + std::to_string(drive_max_resend) + "]");
     }
     catch (const std::exception& e)
     {
@@ -158,6 +165,19 @@ void DeviceManager::serialPortInit()        //不使用一个线程一个连接,
         return;
     }
 
+    if (!drivePipeline)
+    {
+        driveAckTracker = std::make_unique<DriveAckTracker>(serialPortCount, CarsPerSocket, TotalCarNum);
+        driveAckTracker->setAckTimeout(std::chrono::milliseconds(drive_ack_timeout_ms));
+        driveAckTracker->setMaxResend(drive_max_resend);
+        driveAckTracker->setOnSettled([this](int carID, bool) {
+            carFlags.clear(carID, CarFlags::InFlight);      //回码或放弃后允许再次驱动
+        });
+        serialReplyParsers.resize(serialPortCount * 2);    //主连接 + 备用连接
+        drivePipeline = std::make_unique<SerialDrivePipeline>(serialPortCount);
+        drivePipeline->setAckTracker(driveAckTracker.get());
+        drivePipeline->setFailoverAfterLost(drive_failover_lost);
+    }
     if (SerialSockets.size() < static_cast<size_t>(serialPortCount))
     {
         SerialSockets.resize(serialPortCount);
@@ -175,22 +195,16 @@ void DeviceManager::serialPortInit()        //不使用一个线程一个连接,
         const int port = std::stoi(host_vec[i][2]);
 
         SocketClient* conn = new SocketClient();   // 不设 parent（可选）
+        // 回码在统一接收线程中直接解析, 不构造 QByteArray, 回码时间不受主线程排队影响
+        conn->setReceiveHandler([this, i](const char* data, size_t len) {
+            onSerialData(i, data, len, false);
+            return len;
+        });
         try {
             SOCKET ok = conn->ConnectTo(host, port);
             if (ok != INVALID_SOCKET) {
                 log("---- [Initialize] Serial server connected! index: ["
                     + std::to_string(i) + "] IP: [" + host + "], 连接成功!");
-
-                // 接收数据 → 主线程处理
-                connect(conn, &SocketClient::dataReceived,
-                        this, [this, i](const QByteArray& data) {
-                            onSerialDataReceived(i, data);
-                        });
-
-                // 发送命令（主线程调用，SocketClient 内部 send）
-                connect(this, &DeviceManager::driveCommandToIndex,
-                        conn, &SocketClient::sendComand,
-                        Qt::DirectConnection);
             }
             else {
                 log("---- [Error] Serial server connect failed! index: ["
@@ -202,47 +216,51 @@ void DeviceManager::serialPortInit()        //不使用一个线程一个连接,
                 + std::to_string(i) + "] : " + e.what());
         }
         SerialSockets[i] = QPointer<SocketClient>(conn);
+        drivePipeline->setSocket(i, conn);
         Sleep(30);
     }
-    // for (int i = 0; i < serialPortCount; ++i) {             //备用连接初始化
-
-    //     // 已连接则跳过
-    //     if (!secondSerialSockets[i].isNull() && secondSerialSockets[i]->SocketConnection)
-    //         continue;
-
-    //     const std::string host = host_vec[i][1];
-    //     const int port = std::stoi(host_vec[i][2]);
-
-    //     SocketClient* conn = new SocketClient();   // 不设 parent（可选）
-    //     try {
-    //         SOCKET ok = conn->ConnectTo(host, port);
-    //         if (ok != INVALID_SOCKET) {
-    //             log("---- [Initialize] Second Serial server connected! index: ["
-    //                 + std::to_string(i) + "] IP: [" + host + "],连接成功!");
+    auto backup_vec = _sqlQuery->readTable("serial_server_backup_config");      //备用串口服务器, 与主连接同时保持
+    if (backup_vec.size() != static_cast<size_t>(serialPortCount)) {
+        log("---- [Warning] serial_server_backup_config 未配置或数量不符, 不启用备用连接");
+    }
+    else {
+        for (int i = 0; i < serialPortCount; ++i) {             //备用连接初始化
+            // 已连接则跳过
+            if (!secondSerialSockets[i].isNull() && secondSerialSockets[i]->SocketConnection)
+                continue;
+            if (backup_vec[i].size() < 3) continue;
 
-    //             // 接收数据 → 主线程处理
-    //             connect(conn, &SocketClient::dataReceived,
-    //                     this, [this, i](const QByteArray& data) {
-    //                         onSerialDataReceived(i, data);
-    //                     });
+            const std::string host = backup_vec[i][1];
+            const int port = std::stoi(backup_vec[i][2]);
 
-    //             // 发送命令（主线程调用，SocketClient 内部 send）
-    //             connect(this, &DeviceManager::driveCommandToIndex,
-    //                     conn, &SocketClient::sendComand,
-    //                     Qt::DirectConnection);
-    //         }
-    //         else {
-    //             log("---- [Error] Second Serial server connect failed! index: ["
-    //                 + std::to_string(i) + "] IP: [" + host + "], 连接失败! ");
-    //         }
-    //     }
-    //     catch (const std::exception& e) {
-    //         log("---- [Exception] Second Serial connect exception index ["
-    //             + std::to_string(i) + "] : " + e.what());
-    //     }
-    //     secondSerialSockets[i] = QPointer<SocketClient>(conn);
-    //     Sleep(30);
-    // }
+            SocketClient* conn = new SocketClient();   // 不设 parent（可选）
+            // 备用连接的回码使用独立的解析器, 回码同样计入该组的回码跟踪
+            conn->setReceiveHandler([this, i](const char* data, size_t len) {
+                onSerialData(i, data, len, true);
+                return len;
+            });
+            try {
+                SOCKET ok = conn->ConnectTo(host, port);
+                if (ok != INVALID_SOCKET) {
+                    log("---- [Initialize] Second Serial server connected! index: ["
+                        + std::to_string(i) + "] IP: [" + host + "],连接成功!");
+                }
+                else {
+                    log("---- [Error] Second Serial server connect failed! index: ["
+                        + std::to_string(i) + "] IP: [" + host + "], 连接失败! ");
+                }
+            }
+            catch (const std::exception& e) {
+                log("---- [Exception] Second Serial connect exception index ["
+                    + std::to_string(i) + "] : " + e.what());
+            }
+            secondSerialSockets[i] = QPointer<SocketClient>(conn);
+            drivePipeline->setStandbySocket(i, conn);
+            Sleep(30);
+        }
+    }
+    drivePipeline->healthCheck();       //主连接失败的组直接使用备用连接
+    drivePipeline->start();
 }
 void DeviceManager::handleCommandSent(int socketIndex, bool success)
 {
@@ -254,10 +272,13 @@ void DeviceManager::handleCommandSent(int socketIndex, bool success)
         log("---- [Error] Command failed to send to serial socket index [" + std::to_string(socketIndex) + "]");
     }
 }
-void DeviceManager::onSerialDataReceived(int socketIndex, const QByteArray& data)
+void DeviceManager::onSerialData(int socketIndex, const char* data, size_t len, bool standby)    //统一接收线程中调用
 {
-    QString hex = data.toHex(' ').toUpper();
-    //log("---- [小车回码] 第 [" + std::to_string(socketIndex) + "] 个端口, 回码数据: [" + hex.toStdString() + "]");
+    int parserIndex = standby ? socketIndex + serialPortCount : socketIndex;
+    if (socketIndex < 0 || parserIndex >= static_cast<int>(serialReplyParsers.size()) || !driveAckTracker) return;
+    serialReplyParsers[parserIndex].feed(data, len, [this, socketIndex](const uint8_t* frame) {
+        driveAckTracker->onReply(socketIndex, frame);
+    });
 }
 bool DeviceManager::driveByCarID(int car_id,
                                  uint64_t lastCarPositionVersion,
@@ -273,7 +294,11 @@ bool DeviceManager::driveByCarID(int car_id,
             log("---- [错误] driveByCarID: 小车号 [" + std::to_string(car_id) + "] 不存在!");
             return false;
         }
-        std::array<uint8_t, 8> data{};
+        if (carFlags.test(car_id, CarFlags::Faulty)) {      //故障小车不再占用串口发送
+            log("---- [错误] driveByCarID: 小车号 [" + std::to_string(car_id) + "] 故障, 不发送命令帧!");
+            return false;
+        }
+        DriveFrame data{};
         data[0] = 0x84;
         int servialCarID = ((car_id - 1) % CarsPerSocket) + 1; //获取在串口服务器的编号
         data[1] = Corotation ? static_cast<uint8_t>(servialCarID) : static_cast<uint8_t>(servialCarID + 0x40);
@@ -288,26 +313,22 @@ bool DeviceManager::driveByCarID(int car_id,
             checksum ^= data[i];
         }
         data[7] = checksum;
-        std::string commandString = std::string(reinterpret_cast<char*>(data.data()), data.size());
-
-        QByteArray command = QByteArray::fromStdString(commandString);
 
         int index = (car_id - 1) / CarsPerSocket;
         // 边界校验...
-        if (index < 0 || index >= static_cast<int>(SerialSockets.size()))
+        if (!drivePipeline || index < 0 || index >= static_cast<int>(SerialSockets.size()))
         {
             log("---- [错误] driveByCarID: 串口服务器索引 [" + std::to_string(index) + "] 超出数量范围!");
             return false;
         }
-        auto connPtr = SerialSockets[index].get();
-        if(connPtr == nullptr || !connPtr->SocketConnection)
+        DriveCommand cmd{ car_id, seqNum.fetch_add(1, std::memory_order_relaxed) + 1, data };
+        carFlags.set(car_id, CarFlags::InFlight);       //先置位, 避免回码先于置位到达
+        if (!drivePipeline->submit(index, cmd))       //交给该串口服务器的发送线程, 不在调用线程中阻塞
         {
-            log("---- [错误] driveByCarID: 串口服务器索引 [" + std::to_string(index) + "] 未连接!");
+            carFlags.clear(car_id, CarFlags::InFlight);
+            log("---- [错误] driveByCarID: 串口服务器索引 [" + std::to_string(index) + "] 未连接或发送队列已满!");
             return false;
         }
-        connPtr->sendComand(index, command);
-        QString commandQStr = command.toHex(' ').toUpper();
-        log("---- [命令帧] 发送: [" + commandQStr.toStdString() + "] 至第 [" + std::to_string(index + 1) + "] 个TCP端口, [" + std::to_string(car_id) + "] 小车运动!");
         return true;
     }
     catch (const std::exception& e)
@@ -320,12 +341,14 @@ bool DeviceManager::driveByCarID(int car_id,
 void DeviceManager::startLoop()
 {
     m_polling = true;
+    unloadScheduler.start();
     m_pollCarThread = std::thread(&DeviceManager::carLoop, this);     //小车位置轮询线程
     m_slotThread = std::thread(&DeviceManager::slotLoop, this);
 }
 void DeviceManager::stopLoop()
 {
     m_polling = false;
+    unloadScheduler.stop();
     if (m_slotThread.joinable())
     {
         m_slotThread.join();
@@ -368,8 +391,9 @@ void DeviceManager::testCarLoop()
 {
     while (m_test.load())
     {
-        for (int i = 1; i < 203; i++)
+        for (int i = 1; i <= TotalCarNum; i++)
         {
+            if (carFlags.test(i, CarFlags::Locked | CarFlags::Faulty | CarFlags::InFlight)) continue;     //锁定/故障/上一条命令未结束的小车不测试
             driveByCarID(i, carLoop_readCarStatusVersion.load(std::memory_order_acquire));
             if (m_test.load() == false) break;
             Sleep(500);
@@ -428,7 +452,9 @@ DeviceManager::~DeviceManager()
 }
 void DeviceManager::cleanup()
 {
+    _linkSupervisor.stop();     //先停止重连, 避免断开过程中又被连上
     stopLoop();
+    if (drivePipeline) drivePipeline->stop();
     tcp_disconnection();
     carItemsWriter.reset();
 }
@@ -439,17 +465,18 @@ void DeviceManager::tcp_disconnection()
         _headTcp.disconnect();
         _stepTcp.disconnect();
         _emptyTcp.disconnect();
-        // _cameraClient41.disconnect();
-        // _cameraClient42.disconnect();
-        _s7QueryPlcSlot.DisconnectFromPLC();
-        // _cameraSendCarId41.disconnect();
-        for (int i = 0; i < serialPortCount; ++i)
+        for (auto& station : _stations) station->carIdLink.disconnect();
+        {
+            std::lock_guard<std::mutex> s7lk(_s7Lock);
+            _s7QueryPlcSlot.DisconnectFromPLC();
+        }
+        for (int i = 0; i < static_cast<int>(SerialSockets.size()); ++i)
         {
-            SerialSockets[i].get()->disconnect();
+            if (!SerialSockets[i].isNull()) SerialSockets[i]->disconnect();
             SerialSockets[i].clear();
-            secondSerialSockets[i].get()->disconnect();
+            if (!secondSerialSockets[i].isNull()) secondSerialSockets[i]->disconnect();
             secondSerialSockets[i].clear();
-            _serialSocketsLock[i].reset();
+            if (i < static_cast<int>(_serialSocketsLock.size())) _serialSocketsLock[i].reset();
         }
     }
     catch (...)
@@ -457,29 +484,30 @@ void DeviceManager::tcp_disconnection()
 
     }
 }
-void DeviceManager::updateCodeToCarMap(const std::string& code, int car_id)
+void DeviceManager::updateCodeToCarMap(const WaybillCode& code, int car_id)
 {
     try
     {
-        std::string copy_code = code;
+        const WaybillCode copy_code = code;
         int copy_car_id = car_id;
         if(copy_car_id<1||copy_car_id>TotalCarNum){
             log("---- [updateCodeToCarMap] 单号:["+code+"], 小车号超出索引范围! 小车号: ["+std::to_string(car_id)+"]");
             return;
         }
+        if (carFlags.blocked(copy_car_id)) {                //锁定/故障小车不绑定面单
+            log("---- [updateCodeToCarMap] 单号:["+code+"], 小车: ["+std::to_string(car_id)+"] 处于故障/锁定状态, 不绑定!");
+            return;
+        }
         int vector_car_id = car_id - 1;
-        const std::string& item_code = carItems[vector_car_id].code;        //因为是顺着小车走, 不会短时间访问同一个小车, 不加锁
+        auto items = carItemsWriter->snapshot();
+        if (vector_car_id >= (int)items->items.size()) return;
+        const WaybillCode& item_code = items->items[vector_car_id].code;
 
         if(item_code == code){                              //小车上的单号是同一个, 不进行写入
             return;
         }
 
-        std::unique_lock<std::shared_mutex> writelock(_codeToCarLock, std::try_to_lock);
-        if(writelock.owns_lock()){
-            // codeToCarMap[copy_code] = copy_car_id;
-            codeToCarMap.insert_or_assign(copy_code, copy_car_id);
-            writelock.unlock();
-        }
+        codeToCarMap.put(copy_code, copy_car_id);      //只锁该面单所在分片, 不再因抢锁失败丢失绑定
         carItemsWriter->writeItemInfo(copy_car_id, copy_code);
     }
     catch (const std::exception& e)
@@ -487,30 +515,34 @@ void DeviceManager::updateCodeToCarMap(const std::string& code, int car_id)
         log("---- [updateCodeToCarMap] 异常: " + std::string(e.what()));
     }
 }
-void DeviceManager::updateSlotByCarID(int car_id, int slot_id)     //设置小车对应的格口号
+void DeviceManager::updateSlotByCarID(int car_id, int slot_id, const WaybillCode& code)     //设置小车对应的格口号
 {
     try
     {
         int copy_slot_id = slot_id;
         int copy_car_id = car_id;
         if (copy_car_id <1 || copy_car_id>TotalCarNum) return;
+        if (carFlags.blocked(copy_car_id)) {                //故障/锁定小车不分配格口
+            log("---- [设置格口] 小车号: [" + std::to_string(copy_car_id) + "] 处于故障/锁定状态, 不设置格口!");
+            return;
+        }
         if (copy_slot_id<1 || copy_slot_id>TotalPortNum)    //掉异常口
         {
             copy_slot_id = test_slot_id.load();
         }
-        int position = outports_map[copy_slot_id].position;
-        int offset = outports_map[copy_slot_id].offset;
-        bool inside = outports_map[copy_slot_id].inside;
+        OutPortInfo port{};
+        if (!resolvePort(copy_slot_id, port)) {             //格口与强排口都未配置, 不能给出下件位置
+            log("---- [设置格口] 格口号: [" + std::to_string(slot_id) + "] 与强排口均未配置, 小车号: [" + std::to_string(copy_car_id) + "] 不设置格口!");
+            return;
+        }
         int vector_car_id = copy_car_id - 1;
 
-        std::shared_lock<std::shared_mutex> readlock(carItemsLock);
-        int item_slot_id = carItems[vector_car_id].port_num;
-        readlock.unlock();
-
-        if (item_slot_id == copy_slot_id) return;       //格口没有变化, 不更新
-        carItemsWriter->writeSlotInfo(copy_car_id, copy_slot_id, position, offset, inside);
-        carLoop_readCarItemsVersion.fetch_add(1,std::memory_order_release);         //20260101修改
-        // carLoop_readCarItems.store(true);   //更新了item中下件信息, carloop中需要读取
+        auto items = carItemsWriter->snapshot();
+        if (vector_car_id >= (int)items->items.size()) return;
+        const CarItem& item = items->items[vector_car_id];
+        if (item.code == code && item.port_num == copy_slot_id) return;       //格口没有变化, 不更新
+        //面单绑定可能仍在写线程队列中, 以面单为条件而不是以读到的格口/代数为条件; 小车已下件或换了面单时不生效
+        carItemsWriter->writeSlotInfo(copy_car_id, copy_slot_id, port.position, port.offset, port.inside, CarItemsWriteThread::Expect::onCode(code));
     }
     catch (const std::exception& e)
     {
@@ -518,24 +550,16 @@ void DeviceManager::updateSlotByCarID(int car_id, int slot_id)     //设置小
         else    log("---- [down setCarSlot] Exception: " + std::string(e.what()));
     }
 }
-void DeviceManager::updateSlotByCode(const std::string& code, int slot_id)
+void DeviceManager::updateSlotByCode(const WaybillCode& code, int slot_id)
 {
     try
     {
-        std::string copy_code = code;
+        const WaybillCode copy_code = code;
         int copy_slot_id = slot_id;
-        std::shared_lock<std::shared_mutex> readlock(_codeToCarLock);
-        auto it = codeToCarMap.find(copy_code);
-        if (it != codeToCarMap.end())
+        int car_id = 0;
+        if (codeToCarMap.take(copy_code, car_id))       //查找与删除在同一分片锁内完成
         {
-            int car_id = it->second;
-            readlock.unlock();
-            codeToCarMap.erase(it);
-            updateSlotByCarID(car_id, copy_slot_id);
-        }
-        else
-        {
-            readlock.unlock();
+            updateSlotByCarID(car_id, copy_slot_id, copy_code);
         }
     }
     catch (const std::exception& e)
@@ -543,150 +567,276 @@ void DeviceManager::updateSlotByCode(const std::string& code, int slot_id)
         log("---- [更新格口] 通过面单号查找对应小车进行更新格口异常: " + std::string(e.what()));
     }
 }
-void DeviceManager::updateCarForCamera()
+void DeviceManager::updateCarForCamera(std::chrono::steady_clock::time_point stepTime)
 {
     try
     {
-        int current_passingCar = passingCarNum;
-        int carForCamera41 = ((current_passingCar + _camera41Position) - 1) % TotalCarNum + 1;
-        int carForCamera42 = ((current_passingCar + _camera42Position) - 1) % TotalCarNum + 1;
-
-        step_camera41Count.fetch_add(1,std::memory_order_release);              //41相机计数累加
-        _currentCarIdFor41.store(carForCamera41,std::memory_order_release);     //修改当前对应车号, 加入std::memory_order_release 确保读取到的数据一致性
-
-        step_camera42Count.fetch_add(1,std::memory_order_release);              //42相机计数累加
-        _currentCarIdFor42.store(carForCamera42,std::memory_order_release);
-        // _currentCarIdFor42 = carForCamera42;
+        int current_passingCar = carRing.passing();
+        bool synced = headSync.inSync();        //失步期间的触发仍占用序号, 但小车号不可信, 回传不绑定
+        double stepIntervalMs = lineSpeed.intervalMs();     //匹配窗口不超过半个步进间隔
+        for (auto& station : _stations)
+        {
+            int carForStation = ((current_passingCar + station->position.load(std::memory_order_relaxed)) - 1) % TotalCarNum + 1;
+            station->triggers.record(carForStation, stepTime, synced, stepIntervalMs);
+            if (!synced || !station->carIdLink.client.SocketConnection) continue;     //失步时不下发不可信的小车号
+            if (carForStation < 1 || carForStation > static_cast<int>(carIdFrames.size())) continue;
+            const CarIdFrame& frame = carIdFrames[carForStation - 1];
+            if (station->carIdLink.client.trySendRaw(frame.data, frame.len)) {      //非阻塞, 发送缓冲满计为失败
+                station->carIdLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stepTime).count());
+            }
+            else {
+                station->carIdFailed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
     }
     catch (const std::exception& e)
     {
         log("---- [相机位置] 更新小车号异常: " + std::string(e.what()));
     }
 }
-std::tuple<uint64_t,int> DeviceManager::carToCamera41()  //返回当前相机41的计数以及对应小车号
+LineSpeedInfo DeviceManager::currentLineSpeed()
+{
+    LineSpeedInfo info{};
+    double interval = lineSpeed.intervalMs();
+    info.one_car_time = static_cast<int>(std::lround(interval));
+    info.speed = (interval > 0 && oneCarTime > 0) ? static_cast<int>(std::lround(oneCarTime * 100.0 / interval)) : 100;   //相对配置线速的百分比
+    info.offset = interval > 0 ? info.one_car_time - oneCarTime : 0;      //单车时间相对配置值的偏差
+    info.wait_load_time = 0;
+    return info;
+}
+double DeviceManager::offsetScale()
+{
+    //格口偏移量是按配置线速(one_car_time)标定的毫秒数, 线速变化时按比例缩放
+    double interval = lineSpeed.intervalMs();
+    if (interval <= 0 || oneCarTime <= 0) return 1.0;
+    double scale = interval / oneCarTime;
+    if (scale < 0.5 || scale > 2.0) return 1.0;       //偏差过大视为拟合异常, 不缩放
+    return scale;
+}
+bool DeviceManager::resolvePort(int& slot_id, OutPortInfo& info) const
 {
-    if(!headDiffMs_isTrue.load(std::memory_order_acquire))          //经过小车时间与头车时间差不匹配
+    auto ports = portTable.load();
+    auto it = ports->find(slot_id);
+    if (it == ports->end())             //格口号在范围内但未配置, 按异常口处理
     {
-        step_camera41Count.store(0,std::memory_order_release);
+        slot_id = test_slot_id.load();
+        it = ports->find(slot_id);
+        if (it == ports->end()) return false;
     }
-    return std::make_tuple(step_camera41Count.load(std::memory_order_acquire),_currentCarIdFor41.load(std::memory_order_acquire));
+    info = it->second;
+    return true;
 }
-std::tuple<uint64_t,int> DeviceManager::carToCamera42()  //返回当前相机42的计数以及对应小车号
+void DeviceManager::applyOffsetCalibration()
 {
-    if(!headDiffMs_isTrue.load(std::memory_order_acquire))          //经过小车时间与头车时间差不匹配
+    if (!offsetCalibrator.enabled()) return;
+    double interval = lineSpeed.intervalMs() > 0 ? lineSpeed.intervalMs() : oneCarTime;
+    if (interval <= 0) return;
+    auto revolution = std::chrono::microseconds(static_cast<int64_t>(interval * 1000.0 * TotalCarNum));
+    std::unordered_map<int, int> baseOffset;
+    for (const auto& kv : *portTable.load()) baseOffset[kv.first] = kv.second.offset;
+    std::vector<OffsetCalibrator::Learned> learned;
+    offsetCalibrator.collect(std::chrono::steady_clock::now(), revolution, baseOffset, learned);
+    if (learned.empty()) return;
+
+    auto _sqlQuery = SqlConnectionPool::instance().acquire();
+    if(!_sqlQuery){
+        log("----[sql异常] DeviceManager 连接是空指针!");
+        return;
+    }
+    std::vector<std::pair<int, int>> applied;       //写库成功的 {格口号, 新偏移量}
+    for (const auto& result : learned)
     {
-        step_camera42Count.store(0,std::memory_order_release);
+        if (result.newOffset == result.oldOffset) continue;
+        if (_sqlQuery->updateValue("outport_config", "port_id", std::to_string(result.portID), "offset", std::to_string(result.newOffset))) {
+            applied.emplace_back(result.portID, result.newOffset);
+            log("---- [偏移标定] 格口 [" + std::to_string(result.portID) + "] 偏移量: [" + std::to_string(result.oldOffset) + "] -> [" + std::to_string(result.newOffset) + "]");
+        }
+        else {
+            log("---- [偏移标定] 格口 [" + std::to_string(result.portID) + "] 偏移量写入数据库失败");
+        }
     }
-    return std::make_tuple(step_camera42Count.load(std::memory_order_acquire),_currentCarIdFor42.load(std::memory_order_acquire));
+    if (applied.empty()) return;
+    std::lock_guard<std::mutex> lk(portTableWriteLock);
+    auto ports = std::make_shared<PortTable>(*portTable.load());     //复制最新表修改后整表发布, 读线程不受影响
+    for (const auto& kv : applied)
+    {
+        auto it = ports->find(kv.first);
+        if (it != ports->end()) it->second.offset = kv.second;
+    }
+    portTable.publish(std::move(ports));
 }
-void DeviceManager::updateCamera41Count(uint64_t new_count){
-    step_camera41Count.store(new_count,std::memory_order_release);
+void DeviceManager::initPhotoFramers()
+{
+    //光电数据在统一接收线程中分帧并直接处理, 一次 recv 中的多个步进按顺序全部生效
+    stepFramer = MessageFramer::fixed(photo_frame_bytes);
+    headFramer = MessageFramer::fixed(photo_frame_bytes);
+    emptyFramer = MessageFramer::fixed(photo_frame_bytes);
+    _stepTcp.client.setReceiveHandler([this](const char* data, size_t len) {
+        return stepFramer.feed(data, len, [this](const char* frame, size_t n) { return stepReceive(frame, n); });
+    });
+    _headTcp.client.setReceiveHandler([this](const char* data, size_t len) {
+        return headFramer.feed(data, len, [this](const char* frame, size_t n) { return headReceive(frame, n); });
+    });
+    _emptyTcp.client.setReceiveHandler([this](const char* data, size_t len) {
+        return emptyFramer.feed(data, len, [this](const char* frame, size_t n) { return emptyReceive(frame, n); });
+    });
+    if (photo_frame_bytes > 0) log("---- [光电分帧] 定长帧, 帧长: [" + std::to_string(photo_frame_bytes) + "] 字节");
+    else log("---- [光电分帧] 未配置 photo_frame_bytes, 按单次接收作为一帧");
 }
-void DeviceManager::updateCamera42Count(uint64_t new_count){
-    step_camera42Count.store(new_count,std::memory_order_release);
+bool DeviceManager::decodePhotoValue(const char* data, size_t len, uint64_t& value)
+{
+    if (len == 0 || len > sizeof(uint64_t)) return false;
+    value = 0;
+    for (size_t i = 0; i < len; ++i)        //大端, 与原 toHex().toULongLong(16) 一致
+        value = (value << 8) | static_cast<uint8_t>(data[i]);
+    return true;
 }
-void DeviceManager::stepReceive(const QByteArray& data) //步进接收
+bool DeviceManager::stepReceive(const char* data, size_t len) //步进接收
 {
     try
     {
-        QByteArray hex = data.toHex();
-        bool ok = false;
-        int passingCar = hex.toULongLong(&ok, 16);
+        uint64_t value = 0;
+        if (!decodePhotoValue(data, len, value) || value > static_cast<uint64_t>(TotalCarNum)) {
+            log("---- [步进光电] 非法帧, 长度: [" + std::to_string(len) + "], 值: [" + std::to_string(value) + "]");
+            return false;
+        }
+        int passingCar = static_cast<int>(value);
         StepLogger::getInstance().Log("---- [步进光电] 接收数据: ["+ std::to_string(passingCar)+"]");
-        passingCarNum = passingCar;
-        carLoop_passingCarNum.store(passingCar,std::memory_order_release);
-        // auto nowTp = std::chrono::steady_clock::now().time_since_epoch();   //当前触发步进时间
-        // int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(nowTp).count();    //转化为纳秒
-        // updateCarPosition();    //更新全局小车状态
-        // carLoop_readCarStatusVersion.fetch_add(1,std::memory_order_release);
-        // updateCarForCamera();
-        // lastStepTimeNs.store(nowNs);
-
-        auto nowTp = std::chrono::steady_clock::now().time_since_epoch();   //当前触发步进时间
-        int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(nowTp).count();    //转化为纳秒
+        auto readTp = SocketReactor::readTime();                            //recv 返回时记录的步进时间
+        double intervalMs = lineSpeed.intervalMs() > 0 ? lineSpeed.intervalMs() : oneCarTime;
+        if (headSync.onStep(passingCar, readTp, intervalMs) == HeadSyncMonitor::StepResult::Duplicate) {
+            StepLogger::getInstance().Log("---- [步进光电] 重复步进: [" + std::to_string(passingCar) + "], 忽略");    //不再重复累加相机计数
+            return true;
+        }
+        int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(readTp.time_since_epoch()).count();    //转化为纳秒
+        lineSpeed.onStep(readTp);
         lastStepTimeNs.store(nowNs);
-        QtConcurrent::run([this] (){
-            updateCarPosition();    //更新全局小车状态
-            updateCarForCamera();
-        });
-
+        updateCarPosition(passingCar);    //更新全局小车状态, O(1)
+        updateCarForCamera(readTp);
     }
     catch (const std::exception& ex)
     {
         log("---- [步进光电] 回传处理异常:" + std::string(ex.what()));
     }
+    return true;
 }
-void DeviceManager::headReceive(const QByteArray& data)  //先发送头车信号, 后发送步进信号1
+bool DeviceManager::headReceive(const char* data, size_t len)  //先发送头车信号, 后发送步进信号1
 {
+    Q_UNUSED(data);
+    Q_UNUSED(len);
     try
     {
         originSignalCount.fetch_add(1,std::memory_order_release);   //头车感应次数累加
-        auto nowTp = std::chrono::steady_clock::now().time_since_epoch();   //当前触发头车时间
+        auto nowTp = SocketReactor::readTime().time_since_epoch();          //recv 返回时记录的头车时间
         int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(nowTp).count();    //转化为纳秒
         lastOriginTimeNs.store(nowNs,std::memory_order_release);                                //记录当前的头车时间
-        carLoop_passingCarNum.store(0,std::memory_order_release);                               //经过0辆车, 用于carloop中判断
+        headSync.onHead(SocketReactor::readTime());                                             //以头车时间为锚点重新同步
+        unloadScheduler.notify();
         StepLogger::getInstance().Log("---- [头车光电] 触发! 当前经过头车次数: ["+std::to_string(originSignalCount)+"]");
     }
     catch (const std::exception& ex) {
         log("---- [头车光电] 数据处理异常: " + std::string(ex.what()));
     }
+    return true;
 }
-void DeviceManager::updateCarPosition()
+void DeviceManager::registerLinks()
 {
-    try
+    auto lineLink = [this](const std::string& name, SocketConnection& conn) {
+        _linkSupervisor.addLink(name,
+            [&conn]() { return conn.client.SocketConnection.load(); },
+            [&conn]() { return conn.reconnect(); },
+            [this, name]() { resyncLineCounters(name); });
+    };
+    lineLink("头车光电", _headTcp);
+    lineLink("步进光电", _stepTcp);
+    lineLink("空车光电", _emptyTcp);
+    for (auto& station : _stations)
     {
-        std::unique_lock<std::shared_mutex> carStatus_writeLock(carStatusLock);
-        for (auto& car_info : carStatus)
-        {
-            int vector_carid = car_info.carID - 1;
-            int currentPosition = (TotalCarNum - passingCarNum + car_info.carID) % TotalCarNum;  //计算当前车的位置, vector中实际小车号从1开始,实际点位从1开始
-            carStatus[vector_carid].currentPosition = currentPosition;   //更新小车位置
-        }
-        carStatus_writeLock.unlock();
-        carLoop_readCarStatusVersion.fetch_add(1,std::memory_order_release);                //更新了小车的位置
-    }
-    catch (const std::exception& e)
+        if (station->carIdIp.empty() || station->carIdPort <= 0) continue;
+        SocketConnection& conn = station->carIdLink;
+        _linkSupervisor.addLink(station->name + "小车号",
+            [&conn]() { return conn.client.SocketConnection.load(); },
+            [&conn]() { return conn.reconnect(); });
+    }
+    _linkSupervisor.addLink("S7格口状态",
+        [this]() {
+            std::lock_guard<std::mutex> s7lk(_s7Lock);
+            return _s7QueryPlcSlot.IsConnected();
+        },
+        [this]() {
+            std::lock_guard<std::mutex> s7lk(_s7Lock);
+            _s7QueryPlcSlot.DisconnectFromPLC();
+            return _s7QueryPlcSlot.ConnectToPLC(main_plc_ip, 0, 1);
+        });
+    auto serialLink = [this](const std::string& name, QPointer<SocketClient> conn) {
+        if (conn.isNull()) return;
+        SocketClient* client = conn.data();     //串口连接在 tcp_disconnection 前一直存在, 守护先于其停止
+        _linkSupervisor.addLink(name,
+            [client]() { return client->SocketConnection.load(); },
+            [client]() { return client->reconnect(); },
+            [this]() { if (drivePipeline) drivePipeline->healthCheck(); });    //当前连接已断开的组切到恢复的连接
+    };
+    for (int i = 0; i < static_cast<int>(SerialSockets.size()); ++i)
     {
-        log("---- [小车位置] 更新异常: " + std::string(e.what()));
+        serialLink("串口服务器" + std::to_string(i), SerialSockets[i]);
+        serialLink("备用串口服务器" + std::to_string(i), secondSerialSockets[i]);
     }
 }
+void DeviceManager::resyncLineCounters(const std::string& reason)
+{
+    //断线期间丢失的头车/步进信号无法补回, 经过车数与头车时间不再可信, 等下一次头车信号重新对齐
+    headSync.reset("[" + reason + "] 重连");     //等待头车, 期间不下件, 相机不按旧计数绑定小车
+    lineSpeed.reset();                  //断线期间的步进间隔不可用
+    unloadScheduler.clear();
+    unloadScheduler.notify();
+    log("---- [连接守护] [" + reason + "] 重连, 暂停下件, 等待头车信号重新同步计数");
+}
+void DeviceManager::updateCarPosition(int passingCar)
+{
+    carRing.rotate(passingCar);                                                         //只更新旋转偏移, 位置按需计算
+    carLoop_readCarStatusVersion.fetch_add(1,std::memory_order_release);                //更新了小车的位置
+    unloadScheduler.notify();                                                           //重新计算到位小车的下件时间
+}
 
-void DeviceManager::emptyReceive(const QByteArray& data)    //空车接收
+bool DeviceManager::emptyReceive(const char* data, size_t len)    //空车接收
 {
     try
     {
-        QByteArray hex = data.toHex();           // e.g. "01A3FF"
-        bool ok = false;
-        int car_id = hex.toULongLong(&ok, 16);
+        uint64_t value = 0;
+        if (!decodePhotoValue(data, len, value) || value < 1 || value > static_cast<uint64_t>(TotalCarNum))  return false;  //小车号不合法
+        int car_id = static_cast<int>(value);
         int vector_carid = car_id - 1;
-        if (car_id<1 || car_id>TotalCarNum)  return;  //小车号不合法
-        std::shared_lock<std::shared_mutex> carItem_rLock(carItemsLock);
-        bool is_fault = carItems[vector_carid].is_fault;   //小车故障状态
-        bool is_loaded = carItems[vector_carid].isLoaded;
-        int run_count = carItems[vector_carid].runTurn_number;
-        carItem_rLock.unlock();
-        if (is_fault)       //小车故障
+        auto items = carItemsWriter->snapshot();
+        if (vector_carid >= (int)items->items.size()) return true;
+        const CarItem& item = items->items[vector_carid];
+        bool is_blocked = carFlags.blocked(car_id);   //小车故障或锁定
+        bool is_loaded = item.isLoaded;
+        int run_count = item.runTurn_number;
+        auto expect = CarItemsWriteThread::Expect::onGeneration(items->generation[vector_carid]);    //读到的状态在写入时仍有效才生效
+        if (is_blocked)       //小车故障或锁定, 不强制排口
         {
-            log("---- [空车回传] 小车号: [" + std::to_string(car_id) + "] 处于故障状态, 不进行空车回传处理!");
-            return;
+            log("---- [空车回传] 小车号: [" + std::to_string(car_id) + "] 处于故障/锁定状态, 不进行空车回传处理!");
+            return true;
         }
         if (originSignalCount.load(std::memory_order_acquire) >= 1)      //头车已转两圈, 确保TCP传输空车数据有效性
         {
             if (!is_loaded)             //如果小车没有上件状态,
             {
+                offsetCalibrator.onCargoDetected(car_id);      //下件后仍有货, 本次标定偏移失败
                 if (run_count <= 3)     //经过3次空车都没有扫描识别数据
                 {
                     run_count += 1;
-                    carItemsWriter->setRunNum(car_id, run_count);
+                    carItemsWriter->setRunNum(car_id, run_count, expect);
                 }
                 else {  //标记小车状态为有货物,并在1号格口强制下格口
                     int port_num = test_slot_id.load();    // 设置强排口
-                    int position = outports_map[port_num].position;
-                    int offset = outports_map[port_num].offset;
-                    bool inside = outports_map[port_num].inside;
+                    OutPortInfo port{};
+                    if (!resolvePort(port_num, port)) {
+                        log("---- [空车回传] 强排口: [" + std::to_string(port_num) + "] 未配置, 小车ID: [" + std::to_string(car_id) + "] 无法强制下件!");
+                        return true;
+                    }
                     log("---- [空车回传] 小车ID: [" + std::to_string(car_id) + "] 是无货状态检测到有货，强制设置格口号为: [" + std::to_string(port_num) + "]");
-                    carItemsWriter->writeSlotInfo(car_id, port_num, position, offset, inside);
-                    carLoop_readCarItemsVersion.fetch_add(1,std::memory_order_release);
+                    carItemsWriter->writeSlotInfo(car_id, port_num, port.position, port.offset, port.inside, expect);
                 }
             }
         }
@@ -694,35 +844,73 @@ void DeviceManager::emptyReceive(const QByteArray& data)    //空车接收
     catch (const std::exception& ex) {
         log("---- [空车光电] 数据处理异常: " + std::string(ex.what()));
     }
+    return true;
 }
 void DeviceManager::slotLoop()
 {
+    int round = 0;
     while (m_polling)
     {
         updateSlotConfig();
+        if (drivePipeline) drivePipeline->healthCheck();    //串口服务器主备连接检查
+        applyOffsetCalibration();
+        size_t expired = codeToCarMap.evictExpired();
+        if (expired > 0) log("---- [面单映射] 清除超时未收到格口的面单: [" + std::to_string(expired) + "]");
+        if (++round % 30 == 0 && driveAckTracker)       //约每分钟输出一次回码统计
+        {
+            log("---- [小车回码] 统计: " + driveAckTracker->summary());
+            log("---- [小车信息] 条件写入冲突: [" + std::to_string(carItemsWriter->conflicts()) + "]");
+            log("---- [面单映射] " + codeToCarMap.summary());
+            for (auto& station : _stations)
+            {
+                log("---- [相机匹配] " + station->name + " " + station->triggers.summary());
+                if (station->carIdLatency.count() > 0 || station->carIdFailed.load() > 0)
+                    log("---- [小车号下发] " + station->name + " " + station->carIdLatency.summary() + ", 失败: [" + std::to_string(station->carIdFailed.load()) + "]");
+            }
+            LineSpeedInfo info = currentLineSpeed();
+            log("---- [头车同步] " + headSync.summary());
+            log("---- [线速估计] " + lineSpeed.summary() + ", 线速: [" + std::to_string(info.speed) + "%], 偏移缩放: [" + std::to_string(offsetScale()) + "]");
+            log("---- [光电分帧] 步进 " + stepFramer.summary() + ", 头车 " + headFramer.summary() + ", 空车 " + emptyFramer.summary());
+        }
         Sleep(2000);
     }
 }
-void DeviceManager::resetCameraPositions()
+void DeviceManager::buildCarIdFrames()
 {
-    auto _sqlQueryBtnClick = SqlConnectionPool::instance().acquire();
-    if(!_sqlQueryBtnClick){
-        log("----[sql异常] DeviceManager 连接是空指针!");
-        return;
+    carIdFrames.assign(TotalCarNum, CarIdFrame{});
+    for (int car = 1; car <= TotalCarNum; ++car)
+    {
+        CarIdFrame& frame = carIdFrames[car - 1];
+        frame.len = std::snprintf(frame.data, sizeof(frame.data), "%d\r\n", car);
     }
+}
+void DeviceManager::connectCarIdLinks()
+{
+    for (auto& station : _stations)
+    {
+        if (station->carIdIp.empty() || station->carIdPort <= 0) continue;
+        station->carIdLink.client.setNonBlockingSend(true);     //在步进接收线程中发送, 对端不读取时不能阻塞
+        bool ok = station->carIdLink.connectTo(station->carIdIp, station->carIdPort, false);    //只发送, 不注册接收
+        log("---- [" + station->name + "] 小车号下发端口 " + station->carIdIp + ":" + std::to_string(station->carIdPort) + (ok ? " 连接成功!" : " 连接失败!"));
+    }
+}
+void DeviceManager::setScannerStations(const std::vector<ScannerStationConfig>& stations)
+{
+    _stations.clear();
+    for (const auto& cfg : stations) _stations.push_back(std::make_unique<StationTrack>(cfg));
+}
+void DeviceManager::resetCameraPositions()
+{
     try
     {
-        auto camera41Pos = _sqlQueryBtnClick->queryString("config", "name", "camera_position_one", "value");
-        if (camera41Pos)
-        {
-            _camera41Position = std::stoi(*camera41Pos);
-            log("---- [41相机] 位置重置为: " + std::to_string(_camera41Position));
-        }
-        auto camera42Pos = _sqlQueryBtnClick->queryString("config", "name", "camera_position_two", "value");
-        if (camera42Pos)
+        for (const auto& cfg : ScannerStationConfig::load())      //只更新位置, 增减扫码站需重启
         {
-            _camera42Position = std::stoi(*camera42Pos);
-            log("---- [42相机] 位置重置为: " + std::to_string(_camera42Position));
+            for (auto& station : _stations)
+            {
+                if (station->id != cfg.id) continue;
+                station->position.store(cfg.position, std::memory_order_relaxed);
+                log("---- [" + station->name + "] 位置重置为: " + std::to_string(cfg.position));
+            }
         }
     }
     catch (const std::exception& e)
@@ -743,6 +931,9 @@ void DeviceManager::resetSlotConfigurations()
         if (!slot_config.empty())
         {
             log("---- [格口配置] 开始重置格口配置...");
+            int max_port_id = 0;
+            std::lock_guard<std::mutex> lk(portTableWriteLock);
+            auto ports = std::make_shared<PortTable>(*portTable.load());     //在当前表上覆盖, 配置表中没有的格口保留原值
             for (const auto& row : slot_config)
             {
                 if (row.size() < 4)continue;
@@ -750,8 +941,11 @@ void DeviceManager::resetSlotConfigurations()
                 int position = std::stoi(row[1]);
                 int offset = std::stoi(row[2]);
                 bool inside = (row[3] == "1");
-                outports_map[port_id] = { port_id, position, offset, inside };
+                (*ports)[port_id] = { port_id, position, offset, inside };
+                max_port_id = std::max(max_port_id, port_id);
             }
+            if (max_port_id > TotalPortNum) TotalPortNum = max_port_id;     //只扩不缩, 避免运行中格口状态表越界
+            portTable.publish(std::move(ports));
         }
         auto strong_slot_config = _sqlQueryBtnClick->queryString("config", "name", "strong_slot", "value");
         if (strong_slot_config)
@@ -762,6 +956,7 @@ void DeviceManager::resetSlotConfigurations()
         auto head_signal_offset = _sqlQueryBtnClick->queryString("config","name","head_signal_offset","value");
         if(head_signal_offset){
             m_head_signal_offset = std::stoi(*head_signal_offset);
+            headSync.setToleranceMs(m_head_signal_offset);
             log("---- [重置配置] 与头车时间差为: ["+*head_signal_offset+"]");
         }
         auto one_car_time = _sqlQueryBtnClick->queryString("config","name","one_car_time","value");
@@ -794,12 +989,20 @@ void DeviceManager::updateSlotConfig()  //查询数据库中格口以及强排
                 log("---- [强排口] 更改为:[" + *test_slot + "]");
             }
         }
-        std::bitset<252> plc_slotStatus;
-        if (_s7QueryPlcSlot.ReadBools274_Bitset(33, 0, 252, plc_slotStatus))
+        auto calibration = _sqlQuery->queryString("config", "name", "offset_calibration", "value");
+        offsetCalibrator.setEnabled(calibration && *calibration == "1");
+
+        std::vector<bool> plc_slotStatus;
+        bool readOk = false;
+        {
+            std::lock_guard<std::mutex> s7lk(_s7Lock);
+            readOk = _s7QueryPlcSlot.ReadBools_Vector(33, 0, TotalPortNum, plc_slotStatus);
+        }
+        if (readOk)
         {
             for (int vector_slot_id = 0; vector_slot_id < TotalPortNum; vector_slot_id++)
             {
-                bool status = plc_slotStatus.test(vector_slot_id);
+                bool status = plc_slotStatus[vector_slot_id];
                 int slot_id = vector_slot_id + 1;
                 if (status != slots_status_map[slot_id])
                 {
@@ -820,46 +1023,35 @@ void DeviceManager::carLoop()
 {
     using clock = std::chrono::steady_clock;
     const int offsetEps = 7;       //格口偏移量误差范围,8ms
-    std::vector<CarItem> copy_carItems;
-    copy_carItems.resize(carItems.size());
-    std::vector<CarInfo> copy_carStatus;
-    copy_carStatus.resize(carStatus.size());
+    std::shared_ptr<const CarItemsSnapshot> carItemsSnap;     //无锁快照, 不再整表复制
+    std::vector<UnloadScheduler::Task> dueTasks;
+    std::vector<int> arrivedCars;           //到达目标位置的小车, 复用避免分配
+    std::vector<uint8_t> arrivedMask;
+    std::vector<int> dirtyCars;             //上次计算后被写入过的小车
     uint64_t lastCarStatusVersion = 0;
-    uint64_t lastCarItemsVersion = 0;
     int64_t prevNs = 0;
-    int copy_passingCarNum = 0;
-    int64_t copy_lastOriginalNs = 0;
+    int ring_passing = 0;                   //本次步进的旋转偏移, 一次计算中保持一致
     int copy_headCount = 0;
     while (m_polling)
     {
         try
         {
+            bool rebuild = false;                                                       //小车信息或位置变化, 需要重新计算下件时间
             int original_count = originSignalCount.load(std::memory_order_acquire);
-            if(copy_headCount != original_count){                                       //头车次数发生改变, 更新头车触发时间, 更新经过的小车数
+            if(copy_headCount != original_count){                                       //头车次数发生改变
                 copy_headCount = original_count;
-                copy_lastOriginalNs = lastOriginTimeNs.load(std::memory_order_acquire);
-                copy_passingCarNum = carLoop_passingCarNum.load(std::memory_order_acquire);
+                rebuild = true;
             }
-            if(original_count == 0){                                                    //头车次数为0, 不进行下述操作
-                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            if(original_count == 0 || !headSync.inSync()){      //未收到头车或头车/步进失步(由同步状态机判断并重新对齐), 等待步进/头车信号唤醒
+                unloadScheduler.clear();
+                dueTasks.clear();
+                lastCarStatusVersion = 0;                       //恢复同步后重新计算
+                if (!unloadScheduler.waitDue(dueTasks)) break;
                 continue;
             }
 
-            uint64_t ver = carLoop_readCarItemsVersion.load(std::memory_order_acquire);
-            if(ver!=lastCarItemsVersion){       //版本不同,需要读取
-                std::shared_lock<std::shared_mutex> read_lock(carItemsLock);
-                //获取锁后再次验证版本
-                uint64_t ver2 = carLoop_readCarItemsVersion.load(std::memory_order_acquire);
-                if(ver2==ver){      //第一次与第二次没有变化
-                    copy_carItems = carItems;
-                    lastCarItemsVersion = ver;
-                }else{
-                    log("----[小车循环] 更新 car_item 出现了漏缺!");
-                    copy_carItems = carItems;
-                    lastCarItemsVersion = ver2;
-                }
-                read_lock.unlock();
-            }
+            carItemsWriter->takeDirty(dirtyCars);           //先取变化的小车再读快照, 快照一定已包含这些写入
+            carItemsSnap = carItemsWriter->snapshot();
             uint64_t position_ver = carLoop_readCarStatusVersion.load(std::memory_order_acquire);
             if(position_ver!=lastCarStatusVersion){
                 prevNs = lastStepTimeNs.load();    //获取最新步进时间,只有在步进触发后再读取
@@ -867,82 +1059,77 @@ void DeviceManager::carLoop()
                     // log("----[小车循环] 最新步进时间有误! 步进时间: ["+std::to_string(prevNs)+"]");
                     continue;
                 }
-                std::shared_lock<std::shared_mutex> read_lock(carStatusLock);
-                uint64_t position_ver2 = carLoop_readCarStatusVersion.load(std::memory_order_acquire);
-                if(position_ver2 == position_ver){
-                    copy_carStatus = carStatus;
-                    lastCarStatusVersion = position_ver;
-                }else{
-                    log("----[小车循环] 更新 car_position 出现了漏缺!");
-                    copy_carStatus = carStatus;
-                    lastCarStatusVersion = position_ver2;
-                }
-                read_lock.unlock();
-                copy_passingCarNum = carLoop_passingCarNum.load(std::memory_order_acquire);                 //获取最新的经过小车数
+                ring_passing = carRing.passing();
+                lastCarStatusVersion = position_ver;
+                rebuild = true;
             }
+            const auto& copy_carItems = carItemsSnap->items;
 
-            //判断当前经过车数与头车触发时间的时间差,若超出数据库中设定的时间则不进行下件
             auto t0 = clock::now();
-            int64_t head_nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t0.time_since_epoch()).count();
-            int64_t head_diffMs = (head_nowNs - copy_lastOriginalNs) / 1'000'000;           //计算当前时间距离上一次头车触发的时间差
-            if(head_diffMs<0) head_diffMs = 0;
-            int passing_carTime = copy_passingCarNum * oneCarTime;
-            if(std::abs(passing_carTime - head_diffMs) > m_head_signal_offset)              //若当前所经过小车时间与头车时间差大于设定值, 不进行以下操作
-            {
-                headDiffMs_isTrue.store(false, std::memory_order_release);                  //用于相机的单号与小车绑定
-                log("---- [小车循环] 经过小车数量与头车时间差之间差值过大! 跳过小车循环!");
-                std::this_thread::sleep_for(std::chrono::milliseconds(15));
-                continue;
-            }
-            if(!headDiffMs_isTrue.load(std::memory_order_acquire))
+
+            if (rebuild || !dirtyCars.empty())        //按本次步进时间计算到位小车的下件时间点
             {
-                headDiffMs_isTrue.store(true, std::memory_order_release);           //用于相机的单号与小车绑定
+                double speedScale = offsetScale();
+                auto stepTp = lineSpeed.predictStep(clock::time_point(std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(prevNs))));     //拟合后的步进时间, 去掉接收抖动
+                const CarTable& table = carItemsSnap->table;
+                auto scheduleCar = [&](int car_id) {
+                    if (carFlags.load(car_id) & CarFlags::NoUnload) return;  //锁定/故障/命令在途
+                    int idx = car_id - 1;
+                    int port_num = table.port[idx];
+                    if (port_num < 1 || port_num > TotalPortNum) return;      //格口不正确, 跳过!
+                    double offsetMs = (table.offset[idx] + offsetCalibrator.deltaFor(port_num)) * speedScale;   //按实测线速缩放
+                    //在原轮询窗口 [offset - offsetEps, offset + offsetEps] 的起点下件: 原来 5ms 轮询在窗口内第一次命中即下件,
+                    //现场标定的 outport_config.offset 都以此为准, 按 offset 本身定时会整体晚几毫秒
+                    auto deadline = stepTp + std::chrono::microseconds(std::llround((offsetMs - offsetEps) * 1000.0));
+                    if (deadline + std::chrono::milliseconds(2 * offsetEps) < t0) return;     //已错过下件窗口
+                    unloadScheduler.schedule({ deadline, car_id, lastCarStatusVersion, carItemsSnap->generation[idx] });
+                };
+                if (rebuild)        //步进/头车变化: 所有小车位置都变了, 整表扫描
+                {
+                    unloadScheduler.clear();
+                    table.collectArrived(ring_passing, arrivedCars, arrivedMask);   //一次扫描找出到达目标位置的小车
+                    for (int car_id : arrivedCars) scheduleCar(car_id);
+                }
+                else                //两次步进之间只有部分小车被写入, 只重新计算这些小车
+                {
+                    for (int car_id : dirtyCars)
+                    {
+                        int idx = car_id - 1;
+                        if (idx < 0 || idx >= table.total) continue;
+                        if (carRing.positionOf(car_id, ring_passing) != table.target[idx]) continue;
+                        scheduleCar(car_id);
+                    }
+                }
             }
 
-            for (const auto& car_info : copy_carStatus)   //循环所有小车
+            dueTasks.clear();
+            if (!unloadScheduler.waitDue(dueTasks)) break;      //睡眠到最近的下件时间或状态变化
+            for (const auto& task : dueTasks)
             {
-                int check_head_count = originSignalCount.load(std::memory_order_acquire);                       //
-                if(check_head_count != copy_headCount)
+                if(originSignalCount.load(std::memory_order_acquire) != copy_headCount)
                 {
-                    log("----[小车循环] for循环中的头车信号被触发!跳出本次循环!");
+                    log("----[小车循环] 下件前头车信号被触发!跳过本次下件!");
                     break;
                 }
-                uint64_t check_position_ver = carLoop_readCarStatusVersion.load(std::memory_order_acquire);     //循环中检查一遍
-                if(check_position_ver!=lastCarStatusVersion)
+                if(carLoop_readCarStatusVersion.load(std::memory_order_acquire) != task.stepVersion)   //小车已离开该位置
                 {
-                    log("----[小车循环] for循环中的小车位置已被改变!跳出本次循环!");
+                    log("----[小车循环] 下件前小车位置已被改变!跳过本次下件!");
                     break;
                 }
+                auto lateMs = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - task.deadline).count();
+                if (lateMs > 2 * offsetEps) continue;          //超出窗口终点 offset + offsetEps
 
-                auto now_tp = clock::now();     //用当前时间进行计算
-                int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
-                int64_t diffMs = (nowNs - prevNs) / 1'000'000; // ms
-                if(diffMs<0) diffMs = 0;
-
-                int car_id = car_info.carID;
-                int vector_carid = car_id - 1;
-                if (vector_carid < 0 || vector_carid >= copy_carItems.size()){
-                    continue;
-                }
-                const auto& car_item = copy_carItems[vector_carid];     //小车上状态及信息
-                std::string code = car_item.code;
-                int currentPosition = car_info.currentPosition;
-                int port_num = copy_carItems[vector_carid].port_num;    //获取格口号
-                if (port_num<1 || port_num>TotalPortNum) continue;      //格口不正确, 跳过!
+                int car_id = task.carID;
+                if (carItemsSnap->generation[car_id - 1] != task.generation) continue;     //小车已被重新写入, 以新任务为准
+                if (carFlags.load(car_id) & CarFlags::NoUnload) continue;      //调度后状态变化, 不占用下件窗口
+                const auto& car_item = copy_carItems[car_id - 1];     //小车上状态及信息
+                int port_num = car_item.port_num;                      //获取格口号
                 bool slot_status = slots_status_map[port_num];          //获取格口状态
-
-                if (car_item.isLoaded
-                    && currentPosition == car_item.targetPosition
-                    && std::abs(car_item.offset - diffMs) <= offsetEps
-                    && copy_headCount >= 1
-                    && slot_status == false
-                )
+                if (car_item.isLoaded && copy_headCount >= 1 && slot_status == false)
                 {
-                    bool inside = car_item.inside;
-                    handleCarUnload(car_id, inside, code, port_num, lastCarStatusVersion);          //传入lastCarStatusVersion 用于socket发送命令帧前, 判断是否为小车当前位置标志
+                    handleCarUnload(car_id, car_item.inside, car_item.code, port_num, task.stepVersion);          //传入stepVersion 用于socket发送命令帧前, 判断是否为小车当前位置标志
                 }
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
         }
         catch (const std::exception& e)
         {
@@ -951,15 +1138,16 @@ void DeviceManager::carLoop()
     }
 }
 
-void DeviceManager::handleCarUnload(int car_id, bool direction, std::string code, int slot_id, uint64_t lastCarStatusVersion) //下件,同时初始化小车
+void DeviceManager::handleCarUnload(int car_id, bool direction, const WaybillCode& code, int slot_id, uint64_t lastCarStatusVersion) //下件,同时初始化小车
 {
     try
     {
         if (car_id<1 || car_id>TotalCarNum) return;                        //小车号不合法
         bool ok = driveByCarID(car_id, lastCarStatusVersion, direction);   //驱动小车到对应格口
         if(ok){                                                             //下件成功
-            carItemsWriter->initCarItem(car_id);                            //初始化对应小车信息
-            carLoop_readCarItemsVersion.fetch_add(1, std::memory_order_release);
+            //只在小车仍是下件时的面单时初始化, 驱动期间新绑定的面单不会被清掉(圈数等其他写入不影响)
+            carItemsWriter->initCarItem(car_id, CarItemsWriteThread::Expect::onCode(code));
+            offsetCalibrator.onUnload(car_id, slot_id, std::chrono::steady_clock::now());
             log("---- [小车下件] 单号: [" + code + "], 小车号: [" + std::to_string(car_id) + "], 格口号: [" + std::to_string(slot_id) + "]");
         }
     }
@@ -977,18 +1165,6 @@ int DeviceManager::getTimeDiff()  //获取当前时间与上一次步进触发
     return timeDiff;
 }
 
-void DeviceManager::initCarPosition(int car_id, int current_position)
-{
-
-    if (car_id< 1 || car_id > TotalCarNum)  return;
-
-    int vector_carid = car_id - 1;
-    //只有在程序最开始起来的时候才使用
-    CarInfo info;
-    info.carID = car_id;            //真实小车号
-    info.currentPosition = current_position;       // 初始位置可以直接设为编号（或根据实际情况调整）
-    carStatus[vector_carid] = info;       // 将该小车状态存入映射，键为 carID
-}
 void DeviceManager::initCarItems(int car_id)
 {
     auto _sqlQuery = SqlConnectionPool::instance().acquire();
@@ -1002,7 +1178,7 @@ void DeviceManager::initCarItems(int car_id)
         int vector_carid = car_id - 1;
         CarItem itemInfo;
         itemInfo.carID = car_id;
-        itemInfo.code = "";                 //面单号为空
+        itemInfo.code.clear();              //面单号为空
         itemInfo.port_num = -1;             //格口号初始化
         itemInfo.targetPosition = -1;       // 初始时无下件目标，可设为 -1 表示无目标
         itemInfo.isLoaded = false;          // 初始状态均为未装货
@@ -1015,14 +1191,13 @@ void DeviceManager::initCarItems(int car_id)
 
             if (error_car&&*error_car == "error")
             {
-                carLocks[vector_carid] = true;
+                carFlags.set(car_id, CarFlags::Faulty | CarFlags::Locked);
                 log("---- [Warning] CarID: [" + std::to_string(car_id) + "] is marked as faulty in the database. It will be locked.");
             }
             else
             {
-                carLocks[vector_carid] = false;
+                carFlags.clear(car_id, CarFlags::Faulty | CarFlags::Locked);
             }
-            itemInfo.is_fault = false;
         }
         carItems[vector_carid] = itemInfo;
     }
@@ -1031,18 +1206,6 @@ void DeviceManager::initCarItems(int car_id)
         log("---- [初始化] 小车信息异常: " + std::string(e.what()));
     }
 }
-void DeviceManager::testCamera()
-{
-    try
-    {
-        _cameraClient41.send("1");
-        _cameraClient42.send("1");
-    }
-    catch (const std::exception& e)
-    {
-        log("---- [测试相机] 异常: " + std::string(e.what()));
-    }
-}
 void DeviceManager::resetDriver()
 {
     auto _sqlQueryBtnClick = SqlConnectionPool::instance().acquire();
@@ -1069,12 +1232,9 @@ void DeviceManager::lockCar(int car_id)
 {
     try {
         if (car_id < 1 || car_id > TotalCarNum) return;  //超出小车索引范围
-        int vector_car_id = car_id - 1;
-        if (!carLocks[vector_car_id])    //小车状态正常, 加锁
+        if (carFlags.set(car_id, CarFlags::Locked))    //小车状态正常, 加锁
         {
-            carLocks[vector_car_id] = true;
             log("---- [锁定小车] 设备线程中已锁住 [" + std::to_string(car_id) + "] 号小车!");
-            carLoop_readCarLocks.store(true);
         }
     }
     catch (const std::exception& e)
@@ -1087,12 +1247,9 @@ void DeviceManager::unlockCar(int car_id)
     try
     {
         if (car_id < 1 || car_id > TotalCarNum) return;  //超出小车索引范围
-        int vector_car_id = car_id - 1;
-        if (carLocks[vector_car_id])    //小车状态锁住, 解锁
+        if (carFlags.clear(car_id, CarFlags::Locked))    //小车状态锁住, 解锁
         {
-            carLocks[vector_car_id] = false;
             log("---- [解锁小车] 设备线程中已解锁 [" + std::to_string(car_id) + "] 号小车!");
-            carLoop_readCarLocks.store(true);
         }
     }
     catch (const std::exception& e)
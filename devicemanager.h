@@ -7,6 +7,20 @@
 #include "StructInfo.h"
 #include "plccontrol.h"
 #include "caritemswritethread.h"
+#include "unloadscheduler.h"
+#include "publishedsnapshot.h"
+#include "carring.h"
+#include "serialdrivepipeline.h"
+#include "connectionsupervisor.h"
+#include "messageframer.h"
+#include "linespeedestimator.h"
+#include "offsetcalibrator.h"
+#include "headsyncmonitor.h"
+#include "carflags.h"
+#include "codecarmap.h"
+#include "cameratriggerring.h"
+#include "scannerstation.h"
+#include "latencyhistogram.h"
 #include <QFutureWatcher>
 
 class DeviceManager : public QObject {
@@ -18,12 +32,11 @@ public:
     void init();
     void dbInit();
     void tcpConnection();
-    void updateCarPosition();
+    void updateCarPosition(int passingCar);
     void carLoop();	//循环遍历下件
 
-    void handleCarUnload(int car_id, bool direction, std::string code, int slot_id, uint64_t targetPosition);
+    void handleCarUnload(int car_id, bool direction, const WaybillCode& code, int slot_id, uint64_t targetPosition);
     int getTimeDiff();
-    void initCarPosition(int car_id, int current_position);
     void initCarItems(int car_id);
     void log(const std::string& message)
     {
@@ -31,12 +44,13 @@ public:
     }
     void startLoop();
     void stopLoop();
-    void updateSlotByCarID(int car_id, int slot_id);	//请求后设置对应小车的格口号
-    void updateSlotByCode(const std::string& code, int slot_id);	//通过面单号查找对应小车, 并设置小车的格口号
+    void updateSlotByCarID(int car_id, int slot_id, const WaybillCode& code);	//请求后设置对应小车的格口号, 只在小车仍是该面单时生效
+    void updateSlotByCode(const WaybillCode& code, int slot_id);	//通过面单号查找对应小车, 并设置小车的格口号
     void updateSlotConfig();
     void slotLoop();
 
     void serialPortInit();
+    void onSerialData(int socketIndex, const char* data, size_t len, bool standby);    //串口服务器回码解析
     bool driveByCarID( int car_id,
                       uint64_t lastCarPositionVersion,
                       bool Corotation = true,
@@ -44,59 +58,96 @@ public:
                       int distance = 80,
                       int acceleration = 100
                       );    //Corotation = true 是正转? mode = 0 上件, mode = 1下件
-    void updateCarForCamera();	//更新当前应拍摄相机的小车id
-    std::tuple<uint64_t,int> carToCamera41();           //返回当前应拍摄41相机的计数以及小车id
-    std::tuple<uint64_t,int> carToCamera42();           //返回当前应拍摄42相机的计数以及小车id
-    void updateCamera41Count(uint64_t new_count);       //根据dataprocess 中的计数来更新
-    void updateCamera42Count(uint64_t new_count);
+    void updateCarForCamera(std::chrono::steady_clock::time_point stepTime);	//记录本次步进时各扫码站下的小车id
+    void setScannerStations(const std::vector<ScannerStationConfig>& stations);     //在 init 之前调用, 之后站点数量不再变化
+    CameraTriggerRing& stationTriggers(int index) { return _stations[index]->triggers; }    //相机回传按触发序号/时间匹配小车
+    int totalCars() const { return TotalCarNum; }
 
-    void updateCodeToCarMap(const std::string& code, int car_id);	//将面单号与小车号绑定
+    void updateCodeToCarMap(const WaybillCode& code, int car_id);	//将面单号与小车号绑定
     void testCarLoop();
     void startCarTestLoop();
     void stopCarTestLoop();
     void resetCameraPositions();
     void resetSlotConfigurations();
-    void testCamera();
     void resetDriver();
     void lockCar(int car_id);
     void unlockCar(int car_id);
 
     void tcp_disconnection();
     void cleanup();
+    ConnectionSupervisor& linkSupervisor() { return _linkSupervisor; }     //相机等外部连接也注册到连接守护, 全部注册后由调用方 start
 private:
+    void registerLinks();           //注册光电/S7/串口服务器连接到连接守护
+    void resyncLineCounters(const std::string& reason);
+    LineSpeedInfo currentLineSpeed();       //由步进间隔拟合得到的实时线速
+    double offsetScale();                   //格口偏移量按线速缩放的比例, 实测单车时间 / 配置单车时间
+    void applyOffsetCalibration();          //标定结果写回 outport_config
+    void initPhotoFramers();        //光电连接分帧, 需在 tcpConnection 之前设置
+    static bool decodePhotoValue(const char* data, size_t len, uint64_t& value);
+    // 光电帧处理, 在统一接收线程中调用; 返回 false 表示帧内容非法
+    bool stepReceive(const char* data, size_t len);
+    bool headReceive(const char* data, size_t len);
+    bool emptyReceive(const char* data, size_t len);    //光电连接重连后, 头车/步进计数需等待下一次头车重新对齐
 
     std::atomic<uint64_t> carLoop_readCarStatusVersion{0};
-    std::atomic<uint64_t> carLoop_readCarItemsVersion{0};
 
-    std::atomic<uint64_t> step_camera41Count {0};             //作为41相机的计数
-    std::atomic<uint64_t> step_camera42Count {0};             //作为42相机的计数
+    struct StationTrack {          //每个扫码站在设备侧的状态: 位置, 最近的触发记录, 小车号下发连接
+        explicit StationTrack(const ScannerStationConfig& cfg)
+            : id(cfg.id), name(cfg.name), position(cfg.position), triggers(cfg.name), carIdIp(cfg.carIdIp), carIdPort(cfg.carIdPort) {}
+        int id;
+        std::string name;
+        std::atomic<int> position;      //重置相机位置时在主线程修改, 步进接收线程读取
+        CameraTriggerRing triggers;
+        std::string carIdIp;            //空 = 该站不下发小车号
+        int carIdPort;
+        SocketConnection carIdLink;
+        LatencyHistogram carIdLatency;  //步进 recv 到小车号发送完成的延时
+        std::atomic<uint64_t> carIdFailed{ 0 };
+    };
+    std::vector<std::unique_ptr<StationTrack>> _stations;
+    struct CarIdFrame {             //预先格式化的小车号帧: 十进制小车号 + "\r\n", 步进时直接发送
+        char data[12];
+        int len;
+    };
+    std::vector<CarIdFrame> carIdFrames;        //下标 = 小车号 - 1
+    void buildCarIdFrames();
+    void connectCarIdLinks();
 
     SocketConnection _stepTcp;
     SocketConnection _headTcp;
     SocketConnection _emptyTcp;
+    MessageFramer stepFramer;
+    MessageFramer headFramer;
+    MessageFramer emptyFramer;
+    int photo_frame_bytes = 0;      //光电定长帧字节数, 0 = 单次接收即一帧
 
     bool IsUpLayerLine = true;
     std::atomic<int64_t> lastStepTimeNs{ 1 }; //上一次步进时间纳秒
-    int passingCarNum = 0;
     int oneCarTime = 0;
     int TotalCarNum, TotalPortNum;
     std::string main_plc_ip = "192.168.93.52";
     std::atomic<int> originSignalCount{ 0 }; //头车感应次数
     std::atomic<int64_t> lastOriginTimeNs{ 1 }; //上一次头车感应时间纳秒
-    std::atomic<int> carLoop_passingCarNum{0};             //用于比较与头车时间差的对比
     int m_head_signal_offset = 0;
-    std::atomic<bool> headDiffMs_isTrue{true};        //经过小车时间与头车时间差 匹配正确
+    HeadSyncMonitor headSync;                       //头车/步进一致性状态机, 失步时不下件, 相机不绑定小车
 
-    std::vector<CarInfo> carStatus;     //小车位置
-    std::shared_mutex carStatusLock;   //多读少写, 线程锁
+    LineSpeedEstimator lineSpeed;       //步进间隔拟合, 预测步进时间
+    OffsetCalibrator offsetCalibrator;  //格口偏移量标定, config.offset_calibration = 1 时启用
+    CarRing carRing;                    //小车位置: 单一旋转偏移, 按需计算位置
 
     std::vector<CarItem> carItems;   //小车扩展状态及信息
     std::shared_mutex carItemsLock;
 
     std::unique_ptr<CarItemsWriteThread> carItemsWriter;	//写入
-    std::unordered_map<int, OutPortInfo> outports_map;    //格口位置
+    UnloadScheduler unloadScheduler;    //下件截止时间调度, carLoop 按需唤醒
+    using PortTable = std::unordered_map<int, OutPortInfo>;
+    PublishedSnapshot<PortTable> portTable;        //格口位置表: 复制-修改-整表发布, 各线程只读查找, 不再在读线程中用 operator[] 插入
+    std::mutex portTableWriteLock;                  //格口重置与偏移标定都基于最新表修改, 写入方之间互斥, 不丢失对方的修改
+    // 查找格口位置; 格口未配置时改用强排口, 强排口也未配置返回 false. slot_id 返回实际使用的格口
+    bool resolvePort(int& slot_id, OutPortInfo& info) const;
 
     PlcControl _s7QueryPlcSlot;
+    std::mutex _s7Lock;                 //S7 读取与重连不在同一线程
     std::unordered_map<int, bool> slots_status_map;	//格口状态 true = 锁格口, false = 可下件
     std::shared_mutex slotsStatus_lock;
 
@@ -110,28 +161,20 @@ private:
     std::atomic<int> test_slot_id{ 0 };	//强排口
 
     int serialPortCount = 9;	//总端口数量(一个串口服务器两个端口)
-    int seqNum = 0;
+    std::atomic<uint32_t> seqNum{ 0 };     //命令帧序号, 用于与小车回码匹配
     static constexpr int CarsPerSocket = 24;	//串口服务器一个端口控制24个小车
     std::vector<QPointer<SocketClient>> SerialSockets;	//串口服务器连接
     std::vector<std::unique_ptr<std::mutex>> _serialSocketsLock;
     std::vector<QPointer<SocketClient>> secondSerialSockets;    //备用服务器连接
+    std::unique_ptr<SerialDrivePipeline> drivePipeline;     //每个串口服务器独立发送线程, 合并发送
+    std::unique_ptr<DriveAckTracker> driveAckTracker;       //命令帧回码跟踪与延时统计
+    std::vector<SerialReplyParser> serialReplyParsers;      //每个串口服务器的回码解析, 只在其接收线程中使用
+    int drive_ack_timeout_ms = 7;       //回码超时, 默认与下件窗口一致
+    int drive_max_resend = 0;          //回码格式确认前不重发, 避免控制器不回传命令帧时每条命令都发两次
+    int drive_failover_lost = 0;        //连续放弃多少条命令后切换主备连接, 0 = 不因回码丢失切换
+
+    CodeCarMap codeToCarMap;        //分片加锁, 带超时清除
 
-    std::unordered_map<std::string, int> codeToCarMap;
-    std::shared_mutex _codeToCarLock;
-
-    SocketConnection _cameraClient41;	//ip为 41相机, 端口2001
-    SocketConnection _cameraClient42;	//ip为 42相机, 端口2002
-    SocketConnection _cameraSendCarId41;    //发送小车号tcp
-    SocketConnection _cameraSendCarId42;
-    int camera41_send_port,camera42_send_port, camera41_send_carid_port,camera42_send_carid_port;
-    std::string camera41_ip = "";
-    std::string camera42_ip = "";
-    std::string camera41_carid_ip = "";
-    std::string camera42_carid_ip = "";
-    int _camera41Position = 80;
-    int _camera42Position = 113;
-    std::atomic<int> _currentCarIdFor41{ 1 };	//41相机对应下的小车id
-    std::atomic<int> _currentCarIdFor42{ 1 };	//42相机对应下的小车id
 
     std::atomic<int> _car_speed_first{ 1 };
     std::atomic<int> _car_distance_first{ 1 };
@@ -140,20 +183,15 @@ private:
     std::atomic<int> _car_distance_second{ 1 };
     std::atomic<int> _car_acceleration_second{ 1 };
 
-    std::vector<bool> carLocks;
-    std::atomic<bool> carLoop_readCarLocks{ true };
+    CarFlags carFlags;      //每辆小车的锁定/故障原子状态位
+
+    ConnectionSupervisor _linkSupervisor;      //断线重连, 带抖动的指数退避
 
     bool isTCPConnectOver = false;
     bool isSerialPortConnectOver = false;
 
 private slots:
-    void stepReceive(const QByteArray& data);
-    void headReceive(const QByteArray& data);
-    void emptyReceive(const QByteArray& data);
     void handleCommandSent(int socketIndex, bool success);    //处理发送串口服务器指令结果
-    void onSerialDataReceived(int socketIndex, const QByteArray& data);
-signals:
-    void driveCommandToIndex(int index, QByteArray command);
 };
 
 
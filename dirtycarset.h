@@ -0,0 +1,47 @@
+#ifndef DIRTYCARSET_H
+#define DIRTYCARSET_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 已变化小车的位图, 每辆小车 1 位. 写入方置位, 调度线程整字交换取走, 均无锁
+class DirtyCarSet {
+public:
+    void resize(int totalCars)      //只在初始化时调用
+    {
+        total_ = totalCars > 0 ? totalCars : 0;
+        words_ = (total_ + 63) / 64;
+        bits_.reset(new std::atomic<uint64_t>[words_]);
+        for (int i = 0; i < words_; ++i) bits_[i].store(0, std::memory_order_relaxed);
+    }
+
+    void mark(int carID)
+    {
+        if (carID < 1 || carID > total_) return;
+        int bit = carID - 1;
+        bits_[bit >> 6].fetch_or(uint64_t(1) << (bit & 63), std::memory_order_release);
+    }
+
+    // 取走并清空所有已置位的小车号, 返回取到的数量
+    size_t take(std::vector<int>& carIDs)
+    {
+        carIDs.clear();
+        for (int w = 0; w < words_; ++w)
+        {
+            uint64_t word = bits_[w].exchange(0, std::memory_order_acq_rel);
+            for (int b = 0; word != 0; ++b, word >>= 1)
+            {
+                if (word & 1) carIDs.push_back(w * 64 + b + 1);
+            }
+        }
+        return carIDs.size();
+    }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> bits_;
+    int words_ = 0;
+    int total_ = 0;
+};
+
+#endif // DIRTYCARSET_H
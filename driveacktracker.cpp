@@ -0,0 +1,158 @@
+#include "driveacktracker.h"
+#include <algorithm>
+
+DriveAckTracker::DriveAckTracker(int socketCount, int carsPerSocket, int totalCars)
+    : carsPerSocket_(carsPerSocket),
+      outstanding_(socketCount, std::vector<Outstanding>(carsPerSocket)),
+      outstandingCount_(socketCount, 0),
+      lostStreak_(socketCount, 0),
+      perCar_(totalCars)
+{
+}
+
+void DriveAckTracker::onSent(int index, const DriveCommand& cmd, clock::time_point sentAt)
+{
+    if (index < 0 || index >= static_cast<int>(outstanding_.size())) return;
+    int slot = (cmd.frame[1] & 0x3F) - 1;
+    if (slot < 0 || slot >= carsPerSocket_) return;
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    Outstanding& o = outstanding_[index][slot];
+    if (o.active && o.cmd.seq == cmd.seq) {     //重发, 只更新发送时间
+        o.sentAt = sentAt;
+        return;
+    }
+    if (o.active) {
+        log("---- [小车回码] 小车 [" + std::to_string(o.cmd.carID) + "] 命令帧 seq: [" + std::to_string(o.cmd.seq) + "] 未回码即被新命令覆盖");
+        ++lost_;
+    }
+    else {
+        ++outstandingCount_[index];
+    }
+    o.active = true;
+    o.cmd = cmd;
+    o.sentAt = sentAt;
+    o.resendCount = 0;
+}
+
+void DriveAckTracker::onReply(int index, const uint8_t* frame)
+{
+    auto now = clock::now();
+    if (index < 0 || index >= static_cast<int>(outstanding_.size())) return;
+    int slot = (frame[1] & 0x3F) - 1;
+    if (slot < 0 || slot >= carsPerSocket_) {
+        ++unmatched_;
+        return;
+    }
+
+    int carID = 0;
+    int64_t latencyUs = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        Outstanding& o = outstanding_[index][slot];
+        if (!o.active) {
+            ++unmatched_;
+            return;
+        }
+        o.active = false;
+        --outstandingCount_[index];
+        lostStreak_[index] = 0;
+        carID = o.cmd.carID;
+        latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(now - o.sentAt).count();
+    }
+    ++acked_;
+    total_.record(latencyUs);
+    if (carID >= 1 && carID <= static_cast<int>(perCar_.size())) perCar_[carID - 1].record(latencyUs);
+    if (onSettled_) onSettled_(carID, true);
+}
+
+void DriveAckTracker::onDropped(int index, const DriveCommand& cmd)
+{
+    if (index >= 0 && index < static_cast<int>(outstanding_.size()))
+    {
+        int slot = (cmd.frame[1] & 0x3F) - 1;
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (slot >= 0 && slot < carsPerSocket_) {
+            Outstanding& o = outstanding_[index][slot];
+            if (o.active && o.cmd.seq == cmd.seq) {     //只撤销本条登记, 已被回码或新命令替换的不动
+                o.active = false;
+                --outstandingCount_[index];
+            }
+        }
+    }
+    if (onSettled_) onSettled_(cmd.carID, false);
+}
+
+int DriveAckTracker::collectTimeouts(int index, clock::time_point now, std::vector<DriveCommand>& resend)
+{
+    if (index < 0 || index >= static_cast<int>(outstanding_.size())) return 0;
+    auto timeout = std::chrono::microseconds(ackTimeoutUs_.load());
+    int maxResend = maxResend_.load();
+
+    std::vector<int> givenUpCars;       //锁外回调
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (outstandingCount_[index] == 0) return 0;
+        for (auto& o : outstanding_[index])
+        {
+            if (!o.active || now - o.sentAt < timeout) continue;
+            if (o.resendCount < maxResend) {
+                ++o.resendCount;
+                ++resent_;
+                resend.push_back(o.cmd);
+                log("---- [小车回码] 小车 [" + std::to_string(o.cmd.carID) + "] seq: [" + std::to_string(o.cmd.seq) + "] 超时未回码, 第 [" + std::to_string(o.resendCount) + "] 次重发");
+            }
+            else {
+                o.active = false;
+                --outstandingCount_[index];
+                ++lost_;
+                ++lostStreak_[index];
+                givenUpCars.push_back(o.cmd.carID);
+                log("---- [小车回码] 小车 [" + std::to_string(o.cmd.carID) + "] seq: [" + std::to_string(o.cmd.seq) + "] 超时未回码, 放弃!");
+            }
+        }
+    }
+    if (onSettled_) {
+        for (int carID : givenUpCars) onSettled_(carID, false);
+    }
+    return static_cast<int>(givenUpCars.size());
+}
+
+bool DriveAckTracker::hasOutstanding(int index)
+{
+    if (index < 0 || index >= static_cast<int>(outstanding_.size())) return false;
+    std::lock_guard<std::mutex> lk(mtx_);
+    return outstandingCount_[index] > 0;
+}
+
+int DriveAckTracker::consecutiveLost(int index)
+{
+    if (index < 0 || index >= static_cast<int>(lostStreak_.size())) return 0;
+    std::lock_guard<std::mutex> lk(mtx_);
+    return lostStreak_[index];
+}
+
+void DriveAckTracker::resetLost(int index)
+{
+    if (index < 0 || index >= static_cast<int>(lostStreak_.size())) return;
+    std::lock_guard<std::mutex> lk(mtx_);
+    lostStreak_[index] = 0;
+}
+
+std::string DriveAckTracker::summary()
+{
+    std::string text = "回码: [" + std::to_string(acked_.load()) + "], 重发: [" + std::to_string(resent_.load())
+        + "], 丢失: [" + std::to_string(lost_.load()) + "], 无匹配: [" + std::to_string(unmatched_.load()) + "], 延时: " + total_.summary();
+    int worstCar = 0;
+    int64_t worstP99 = 0;
+    for (size_t i = 0; i < perCar_.size(); ++i)
+    {
+        int64_t p99 = perCar_[i].percentileUs(0.99);
+        if (p99 > worstP99) {
+            worstP99 = p99;
+            worstCar = static_cast<int>(i) + 1;
+        }
+    }
+    if (worstCar > 0) text += ", 最慢小车: [" + std::to_string(worstCar) + "] " + perCar_[worstCar - 1].summary();
+    return text;
+}
@@ -0,0 +1,126 @@
+#ifndef DRIVEACKTRACKER_H
+#define DRIVEACKTRACKER_H
+#include <array>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "latencyhistogram.h"
+#include "logger.h"
+
+using DriveFrame = std::array<uint8_t, 8>;     //0x84 小车驱动命令帧
+
+struct DriveCommand {
+    int carID;
+    uint32_t seq;           //本地命令序号, 不在帧中发送, 只用于日志和区分重发与新命令
+    DriveFrame frame;
+};
+
+// 小车控制器回码解析: 8 字节帧, [0] = 0x84, [1] = 串口服务器内小车号(反转 +0x40), [7] = [1..6] 异或校验
+// TCP 流式数据按字节累积, 校验失败时丢弃一个字节重新同步
+class SerialReplyParser {
+public:
+    static constexpr uint8_t FrameHeader = 0x84;
+    static constexpr size_t FrameSize = 8;
+
+    template <typename OnFrame>
+    void feed(const char* data, size_t len, OnFrame&& onFrame)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint8_t b = static_cast<uint8_t>(data[i]);
+            if (len_ == 0 && b != FrameHeader) {        //帧头未对齐
+                ++errors_;
+                continue;
+            }
+            buf_[len_++] = b;
+            if (len_ < FrameSize) continue;
+            if (checksumOk()) {
+                onFrame(buf_.data());
+                len_ = 0;
+            }
+            else {
+                ++errors_;
+                resync();
+            }
+        }
+    }
+    uint64_t errors() const { return errors_; }
+
+private:
+    bool checksumOk() const
+    {
+        uint8_t checksum = 0;
+        for (size_t i = 1; i <= 6; ++i) checksum ^= buf_[i];
+        return checksum == buf_[7];
+    }
+    void resync()           //从下一个帧头重新开始
+    {
+        size_t next = 1;
+        while (next < len_ && buf_[next] != FrameHeader) ++next;
+        for (size_t i = next; i < len_; ++i) buf_[i - next] = buf_[i];
+        len_ -= next;
+    }
+
+    std::array<uint8_t, FrameSize> buf_{};
+    size_t len_ = 0;
+    uint64_t errors_ = 0;
+};
+
+// 命令帧回码跟踪: 记录每个小车未回码的命令帧, 统计发送到回码的延时, 超时未回码可选重发.
+// 回码只按 [1] 串口服务器内小车号匹配该车最近一条命令(控制器回码格式尚未确认, 假定回传命令帧), 不能按序号区分同一小车的多条命令;
+// 因此默认不重发(maxResend = 0), 确认回码格式前统计数据仅供参考
+class DriveAckTracker {
+public:
+    using clock = std::chrono::steady_clock;
+
+    DriveAckTracker(int socketCount, int carsPerSocket, int totalCars);
+
+    void setAckTimeout(std::chrono::microseconds timeout) { ackTimeoutUs_.store(timeout.count()); }
+    void setMaxResend(int count) { maxResend_.store(count); }
+    // 命令帧结束(回码 acked = true / 重发后仍未回码放弃 acked = false)时回调, 在锁外调用; 需在发送开始前设置
+    void setOnSettled(std::function<void(int carID, bool acked)> cb) { onSettled_ = std::move(cb); }
+
+    // 在 send() 之前登记, 局域网内回码可能在 send 返回前就到达接收线程
+    void onSent(int index, const DriveCommand& cmd, clock::time_point sentAt);
+    void onReply(int index, const uint8_t* frame);
+    void onDropped(int index, const DriveCommand& cmd);     //主备连接都发送失败, 撤销登记, 命令未发出
+    // 取出超时未回码的命令帧: 未超过重发次数的放入 resend, 超过的放弃; 返回放弃的数量
+    int collectTimeouts(int index, clock::time_point now, std::vector<DriveCommand>& resend);
+    bool hasOutstanding(int index);
+    int consecutiveLost(int index);     //该串口服务器连续放弃的命令数, 收到任一回码清零
+    void resetLost(int index);
+    std::string summary();
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    struct Outstanding {
+        bool active = false;
+        DriveCommand cmd{};
+        clock::time_point sentAt;
+        int resendCount = 0;
+    };
+
+    int carsPerSocket_;
+    std::mutex mtx_;
+    std::vector<std::vector<Outstanding>> outstanding_;    //[串口服务器索引][串口服务器内小车号 - 1]
+    std::vector<int> outstandingCount_;
+    std::vector<int> lostStreak_;                           //[串口服务器索引] 连续放弃数
+    LatencyHistogram total_;
+    std::vector<LatencyHistogram> perCar_;                  //下标为小车号 - 1
+    std::atomic<int64_t> ackTimeoutUs_{ 7000 };             //默认与下件窗口一致
+    std::atomic<int> maxResend_{ 0 };
+    std::atomic<uint64_t> acked_{ 0 };
+    std::atomic<uint64_t> resent_{ 0 };
+    std::atomic<uint64_t> lost_{ 0 };
+    std::atomic<uint64_t> unmatched_{ 0 };
+    std::function<void(int, bool)> onSettled_;
+};
+
+#endif // DRIVEACKTRACKER_H
@@ -0,0 +1,88 @@
+#include "headsyncmonitor.h"
+#include <cmath>
+
+void HeadSyncMonitor::setState(State state, const std::string& reason)
+{
+    if (state_.load(std::memory_order_relaxed) == state) return;
+    state_.store(state, std::memory_order_release);
+    static const char* names[] = { "等待头车", "同步", "失步" };
+    log("---- [头车同步] 状态: [" + std::string(names[static_cast<int>(state)]) + "], " + reason);
+}
+
+void HeadSyncMonitor::reset(const std::string& reason)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    consistent_ = 0;
+    setState(State::WaitingHead, reason);
+}
+
+void HeadSyncMonitor::onHead(clock::time_point when)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (state_.load(std::memory_order_relaxed) != State::WaitingHead)
+    {
+        ++revolutions_;
+        if (revolutionDirty_) ++outOfSyncRevolutions_;
+        if (totalCars_ > 0 && std::abs(totalCars_ - lastPassing_) > 1) {      //头车应在经过整圈小车后出现
+            ++headMisplaced_;
+            log("---- [头车同步] 头车信号位置异常, 上一圈经过车数: [" + std::to_string(lastPassing_) + "]");
+        }
+    }
+    revolutionDirty_ = false;
+    anchor_ = when;
+    lastPassing_ = 0;
+    consistent_ = 0;
+    setState(State::InSync, "头车信号");
+}
+
+HeadSyncMonitor::StepResult HeadSyncMonitor::onStep(int passing, clock::time_point when, double intervalMs)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    State state = state_.load(std::memory_order_relaxed);
+    if (state == State::WaitingHead) {
+        lastPassing_ = passing;
+        return StepResult::Normal;
+    }
+    StepResult result = StepResult::Normal;
+    if (passing == lastPassing_) {
+        ++duplicate_;
+        return StepResult::Duplicate;
+    }
+    if (passing < lastPassing_) {
+        ++regressed_;
+        result = StepResult::Regressed;
+    }
+    else if (passing > lastPassing_ + 1) {
+        missed_ += passing - lastPassing_ - 1;
+        result = StepResult::Missed;
+    }
+    lastPassing_ = passing;
+    if (intervalMs <= 0) return result;
+
+    double tolerance = toleranceMs_ > 0 ? toleranceMs_ : intervalMs / 2;     //未配置容差时按半个单车时间
+    double elapsedMs = std::chrono::duration<double, std::milli>(when - anchor_).count();
+    double diffMs = passing * intervalMs - elapsedMs;
+    if (std::fabs(diffMs) > tolerance || result == StepResult::Regressed)
+    {
+        //以本次步进重新对齐锚点, 后续步进相对新锚点检查
+        anchor_ = when - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(passing * intervalMs));
+        ++realigned_;
+        consistent_ = 0;
+        revolutionDirty_ = true;
+        setState(State::OutOfSync, "经过车数 [" + std::to_string(passing) + "] 与时间偏差 [" + std::to_string(static_cast<int>(diffMs)) + "]ms, 重新对齐");
+    }
+    else if (state == State::OutOfSync && ++consistent_ >= ConfirmSteps)
+    {
+        setState(State::InSync, "重新对齐后连续 " + std::to_string(ConfirmSteps) + " 次步进一致");
+    }
+    return result;
+}
+
+std::string HeadSyncMonitor::summary()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return "圈数: [" + std::to_string(revolutions_) + "], 失步圈数: [" + std::to_string(outOfSyncRevolutions_)
+        + "], 重新对齐: [" + std::to_string(realigned_) + "], 漏步进: [" + std::to_string(missed_)
+        + "], 重复步进: [" + std::to_string(duplicate_) + "], 计数回退: [" + std::to_string(regressed_)
+        + "], 头车位置异常: [" + std::to_string(headMisplaced_) + "]";
+}
@@ -0,0 +1,57 @@
+#ifndef HEADSYNCMONITOR_H
+#define HEADSYNCMONITOR_H
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include "logger.h"
+
+// 头车/步进一致性状态机, 由头车与步进信号驱动(统一接收线程), 取代 carLoop 中每次循环的时间差比较.
+//  WaitingHead 启动或光电重连后等待头车信号, 不下件
+//  InSync      经过车数 * 单车时间 与距头车(或重新对齐的锚点)时间一致, 可下件
+//  OutOfSync   偏差超过容差: 以当前步进重新对齐锚点, 连续若干次步进一致后恢复, 不必等到下一圈头车
+class HeadSyncMonitor {
+public:
+    using clock = std::chrono::steady_clock;
+    enum class State { WaitingHead, InSync, OutOfSync };
+    enum class StepResult { Normal, Missed, Duplicate, Regressed };
+
+    void setTotalCars(int total) { totalCars_ = total; }
+    void setToleranceMs(int ms) { toleranceMs_ = ms; }
+    void reset(const std::string& reason);              //等待头车重新同步
+    void onHead(clock::time_point when);
+    // intervalMs 为当前单车时间; 返回 Duplicate 时调用方不应再次更新小车位置
+    StepResult onStep(int passing, clock::time_point when, double intervalMs);
+    bool inSync() const { return state_.load(std::memory_order_acquire) == State::InSync; }
+    State state() const { return state_.load(std::memory_order_acquire); }
+    std::string summary();
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    void setState(State state, const std::string& reason);     //持锁调用, 只在状态变化时输出日志
+
+    static constexpr int ConfirmSteps = 2;     //重新对齐后连续一致的步进次数
+
+    std::mutex mtx_;
+    std::atomic<State> state_{ State::WaitingHead };
+    int totalCars_ = 0;
+    int toleranceMs_ = 0;
+    int lastPassing_ = 0;
+    clock::time_point anchor_;          //经过 0 辆车的时间点: 头车时间或重新对齐后的推算时间
+    int consistent_ = 0;
+    bool revolutionDirty_ = false;      //本圈是否失步过
+
+    uint64_t missed_ = 0;
+    uint64_t duplicate_ = 0;
+    uint64_t regressed_ = 0;
+    uint64_t realigned_ = 0;
+    uint64_t headMisplaced_ = 0;
+    uint64_t revolutions_ = 0;
+    uint64_t outOfSyncRevolutions_ = 0;
+};
+
+#endif // HEADSYNCMONITOR_H
@@ -0,0 +1,59 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 延时直方图(微秒), 第 i 个桶统计 [2^i, 2^(i+1)) us, 多线程无锁记录
+class LatencyHistogram {
+public:
+    static constexpr int BucketCount = 24;     //最大约 16 秒
+
+    LatencyHistogram() { reset(); }
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(int64_t us)
+    {
+        if (us < 0) us = 0;
+        int bucket = 0;
+        while (bucket < BucketCount - 1 && (int64_t(1) << (bucket + 1)) <= us) ++bucket;
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        int64_t prev = max_.load(std::memory_order_relaxed);
+        while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    int64_t maxUs() const { return max_.load(std::memory_order_relaxed); }
+    int64_t percentileUs(double p) const        //返回所在桶的上界
+    {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(p * total);
+        if (target >= total) target = total - 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BucketCount; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen > target) return int64_t(1) << (i + 1);
+        }
+        return maxUs();
+    }
+    void reset()
+    {
+        for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+    std::string summary() const
+    {
+        return "n=" + std::to_string(count()) + ", p50<=" + std::to_string(percentileUs(0.5)) + "us, p99<=" + std::to_string(percentileUs(0.99)) + "us, max=" + std::to_string(maxUs()) + "us";
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<int64_t> max_;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,85 @@
+#include "linespeedestimator.h"
+#include <cmath>
+
+void LineSpeedEstimator::onStep(clock::time_point readTime)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!samples_.empty() && readTime == samples_.back().time) {    //同一次 recv 中的多个步进, 只保留最后一个的序号
+        samples_.back().index = nextIndex_++;
+        fit();
+        return;
+    }
+    if (fitted_ && !samples_.empty()) {
+        double gapNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(readTime - samples_.back().time).count());
+        double expectNs = slopeNs_ * static_cast<double>(nextIndex_ - samples_.back().index);
+        if (gapNs > expectNs * GapRatio) {      //停线或断线后重新开始拟合
+            samples_.clear();
+            fitted_ = false;
+            ++resets_;
+        }
+    }
+    samples_.push_back({ nextIndex_++, readTime });
+    if (samples_.size() > WindowSize) samples_.pop_front();
+    fit();
+}
+
+void LineSpeedEstimator::reset()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    samples_.clear();
+    fitted_ = false;
+}
+
+void LineSpeedEstimator::fit()
+{
+    fitted_ = false;
+    size_t n = samples_.size();
+    if (n < MinSamples) return;
+    const auto origin = samples_.front().time;
+    const int64_t k0 = samples_.front().index;
+    double sumK = 0, sumT = 0;
+    for (const auto& s : samples_)
+    {
+        sumK += static_cast<double>(s.index - k0);
+        sumT += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(s.time - origin).count());
+    }
+    double meanK = sumK / n, meanT = sumT / n;
+    double sxy = 0, sxx = 0;
+    for (const auto& s : samples_)
+    {
+        double dk = static_cast<double>(s.index - k0) - meanK;
+        double dt = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(s.time - origin).count()) - meanT;
+        sxy += dk * dt;
+        sxx += dk * dk;
+    }
+    if (sxx <= 0) return;
+    double slope = sxy / sxx;
+    if (slope <= 0) return;
+    slopeNs_ = slope;
+    interceptNs_ = meanT - slope * meanK;
+    fitted_ = true;
+}
+
+LineSpeedEstimator::clock::time_point LineSpeedEstimator::predictStep(clock::time_point raw)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!fitted_ || samples_.empty()) return raw;
+    double k = static_cast<double>(samples_.back().index - samples_.front().index);
+    auto predicted = samples_.front().time + std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(static_cast<int64_t>(std::llround(interceptNs_ + slopeNs_ * k))));
+    double residualNs = std::fabs(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(raw - predicted).count()));
+    if (residualNs > slopeNs_ * MaxResidualRatio) return raw;      //线速突变, 拟合尚未跟上
+    return predicted;
+}
+
+double LineSpeedEstimator::intervalMs()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return fitted_ ? slopeNs_ / 1e6 : 0.0;
+}
+
+std::string LineSpeedEstimator::summary()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!fitted_) return "样本不足, 已重置: [" + std::to_string(resets_) + "] 次";
+    return "单车时间: [" + std::to_string(slopeNs_ / 1e6) + "]ms, 样本: [" + std::to_string(samples_.size()) + "], 已重置: [" + std::to_string(resets_) + "] 次";
+}
@@ -0,0 +1,44 @@
+#ifndef LINESPEEDESTIMATOR_H
+#define LINESPEEDESTIMATOR_H
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+// 线速估计: 对最近若干次步进时间做最小二乘直线拟合 t = a + b * k (k 为步进序号),
+// b 即单车经过时间. 拟合后的步进时间去掉了接收抖动, carLoop 以此预测小车到达格口的时间点.
+// 步进时间在统一接收线程 recv 返回时记录, 不含主线程排队延时
+class LineSpeedEstimator {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void onStep(clock::time_point readTime);    //接收线程中调用
+    void reset();
+    // 返回最近一次步进的拟合时间; 样本不足或与拟合偏差过大时返回实际接收时间
+    clock::time_point predictStep(clock::time_point raw);
+    double intervalMs();                        //拟合的单车经过时间, 样本不足返回 0
+    std::string summary();
+
+private:
+    struct Sample {
+        int64_t index;
+        clock::time_point time;
+    };
+    void fit();     //持锁调用
+
+    static constexpr size_t WindowSize = 32;
+    static constexpr size_t MinSamples = 4;
+    static constexpr double GapRatio = 2.5;             //间隔超过拟合值的 2.5 倍视为停线, 重新拟合
+    static constexpr double MaxResidualRatio = 0.25;    //接收时间偏离拟合超过 1/4 单车时间时不使用拟合值
+
+    std::mutex mtx_;
+    std::deque<Sample> samples_;
+    int64_t nextIndex_ = 0;
+    bool fitted_ = false;
+    double interceptNs_ = 0;        //相对 samples_.front().time 的纳秒
+    double slopeNs_ = 0;            //单车经过时间, 纳秒
+    uint64_t resets_ = 0;
+};
+
+#endif // LINESPEEDESTIMATOR_H
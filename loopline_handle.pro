@@ -9,37 +9,70 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    cameratriggerring.cpp \
     caritemswritethread.cpp \
+    codecarmap.cpp \
+    connectionsupervisor.cpp \
     dataprocessmain.cpp \
     devicemanager.cpp \
+    driveacktracker.cpp \
+    headsyncmonitor.cpp \
     licensemanager.cpp \
+    linespeedestimator.cpp \
     logger.cpp \
     main.cpp \
+    offsetcalibrator.cpp \
     loopline_handle.cpp \
     otherfunction.cpp \
     plccontrol.cpp \
     requestapi.cpp \
+    scannerstation.cpp \
+    serialdrivepipeline.cpp \
     snap7.cpp \
     socketclinet.cpp \
+    socketreactor.cpp \
     sqlconnection.cpp \
     sqlconnectionpool.cpp \
-    steplogger.cpp
+    steplogger.cpp \
+    unloadscheduler.cpp \
+    waybillcache.cpp
 
 HEADERS += \
     StructInfo.h \
+    cameratriggerring.h \
+    carflags.h \
+    carring.h \
+    cartable.h \
     caritemswritethread.h \
+    codecarmap.h \
+    connectionsupervisor.h \
     dataprocessmain.h \
     devicemanager.h \
+    dirtycarset.h \
+    driveacktracker.h \
+    headsyncmonitor.h \
+    latencyhistogram.h \
     licensemanager.h \
+    linespeedestimator.h \
     logger.h \
     loopline_handle.h \
+    messageframer.h \
+    mpscring.h \
+    offsetcalibrator.h \
     plccontrol.h \
+    publishedsnapshot.h \
     requestapi.h \
+    scannerstation.h \
+    serialdrivepipeline.h \
     snap7.h \
     socketclinet.h \
+    socketreactor.h \
     sqlconnection.h \
     sqlconnectionpool.h \
-    steplogger.h
+    steplogger.h \
+    unloadscheduler.h \
+    waybillcache.h \
+    waybillcode.h
 
 FORMS += \
     loopline_handle.ui
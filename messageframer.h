@@ -0,0 +1,116 @@
+#ifndef MESSAGEFRAMER_H
+#define MESSAGEFRAMER_H
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// 每个连接一个分帧器, 在统一接收线程中使用. TCP 会合并或拆分消息, 不能把一次 recv 当作一条消息:
+//  Fixed     定长二进制帧(步进/头车/空车光电), 一次 recv 可能带多个步进, 按顺序逐帧处理
+//  Delimited 分隔符结尾的文本帧(相机), 不完整的尾部留在接收缓冲中等待下一次 recv
+//  Chunk     兼容旧行为, 一次 recv 即一帧(未配置帧长/分隔符时使用)
+// 帧直接指向接收缓冲, 不复制; feed 返回已消费的字节数, 未消费部分由接收缓冲保留
+class MessageFramer {
+public:
+    enum class Mode { Chunk, Fixed, Delimited };
+
+    static MessageFramer chunk() { return MessageFramer(Mode::Chunk, 0, '\0'); }
+    static MessageFramer fixed(size_t width) { return width > 0 ? MessageFramer(Mode::Fixed, width, '\0') : chunk(); }
+    static MessageFramer delimited(char delimiter, size_t maxLength = 256) { return MessageFramer(Mode::Delimited, maxLength, delimiter); }
+
+    MessageFramer() = default;
+    MessageFramer(const MessageFramer& other) : mode_(other.mode_), width_(other.width_), delimiter_(other.delimiter_) {}
+    MessageFramer& operator=(const MessageFramer& other)
+    {
+        mode_ = other.mode_;
+        width_ = other.width_;
+        delimiter_ = other.delimiter_;
+        return *this;
+    }
+
+    // onFrame(const char* frame, size_t len) 返回 false 表示帧内容非法, 计为分帧错误;
+    // 定长模式下非法帧只丢弃一个字节, 以便错位后重新对齐
+    template <typename F>
+    size_t feed(const char* data, size_t len, F&& onFrame)
+    {
+        switch (mode_)
+        {
+        case Mode::Fixed:
+        {
+            size_t pos = 0;
+            while (len - pos >= width_)
+            {
+                if (onFrame(data + pos, width_)) {
+                    ++frames_;
+                    pos += width_;
+                }
+                else {
+                    ++errors_;
+                    ++pos;              //错位, 逐字节重新对齐
+                }
+            }
+            return pos;
+        }
+        case Mode::Delimited:
+        {
+            size_t pos = 0;
+            while (pos < len)
+            {
+                const char* end = static_cast<const char*>(std::memchr(data + pos, delimiter_, len - pos));
+                if (!end) break;
+                size_t frameLen = static_cast<size_t>(end - (data + pos));
+                if (frameLen > 0 && delimiter_ == '\n' && data[pos + frameLen - 1] == '\r') --frameLen;    // \r\n 结尾
+                if (frameLen > 0) {
+                    if (frameLen > width_ || !onFrame(data + pos, frameLen)) ++errors_;
+                    else ++frames_;
+                }
+                pos = static_cast<size_t>(end - data) + 1;
+            }
+            if (len - pos > width_) {       //超过最大帧长仍无分隔符, 丢弃
+                ++errors_;
+                ++overflows_;
+                return len;
+            }
+            return pos;
+        }
+        case Mode::Chunk:
+        default:
+            if (len == 0) return 0;
+            if (onFrame(data, len)) ++frames_;
+            else ++errors_;
+            return len;
+        }
+    }
+
+    Mode mode() const { return mode_; }
+    uint64_t frames() const { return frames_.load(); }
+    uint64_t errors() const { return errors_.load(); }
+    uint64_t overflows() const { return overflows_.load(); }
+    std::string summary() const
+    {
+        return "帧数: [" + std::to_string(frames_.load()) + "], 分帧错误: [" + std::to_string(errors_.load())
+            + "], 超长丢弃: [" + std::to_string(overflows_.load()) + "]";
+    }
+
+    // 配置中的分隔符: "LF"/"CR"/"\n" 等转义或单个字符, 为空返回 '\0'(不分帧)
+    static char parseDelimiter(const std::string& text)
+    {
+        if (text.empty()) return '\0';
+        if (text == "LF" || text == "\\n") return '\n';
+        if (text == "CR" || text == "\\r") return '\r';
+        if (text == "ETX") return '\x03';
+        return text[0];
+    }
+
+private:
+    MessageFramer(Mode mode, size_t width, char delimiter) : mode_(mode), width_(width), delimiter_(delimiter) {}
+
+    Mode mode_ = Mode::Chunk;
+    size_t width_ = 0;          //定长模式为帧长, 分隔符模式为最大帧长
+    char delimiter_ = '\0';
+    std::atomic<uint64_t> frames_{ 0 };
+    std::atomic<uint64_t> errors_{ 0 };
+    std::atomic<uint64_t> overflows_{ 0 };
+};
+
+#endif // MESSAGEFRAMER_H
@@ -0,0 +1,83 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// 有界多生产者/单消费者环形队列(按槽位序号同步, 无锁). 元素需可平凡复制, 入队不分配内存.
+// 生产者用 CAS 领取写位置, 写入后发布槽位序号; 消费者按位置顺序取出, 未发布的槽位视为空
+template <typename T>
+class MpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "MpscRing element must be trivially copyable");
+public:
+    explicit MpscRing(size_t capacity)      //容量取不小于 capacity 的 2 的幂
+    {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // 队列满时返回 false, 由调用方决定重试
+    bool tryPush(const T& value)
+    {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;       //消费者尚未取走一整圈之前的元素
+            }
+            else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 只允许单个消费者线程调用
+    bool tryPop(T& out)
+    {
+        Cell& cell = cells_[head_ & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(head_ + 1) < 0) return false;
+        out = cell.value;
+        cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    bool empty() const      //只允许消费者线程调用
+    {
+        const Cell& cell = cells_[head_ & mask_];
+        return static_cast<intptr_t>(cell.seq.load(std::memory_order_acquire)) - static_cast<intptr_t>(head_ + 1) < 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{ 0 };
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    alignas(64) size_t head_ = 0;
+};
+
+#endif // MPSCRING_H
@@ -0,0 +1,99 @@
+#include "offsetcalibrator.h"
+#include <cmath>
+
+const std::vector<int>& OffsetCalibrator::deltas()
+{
+    static const std::vector<int> values{ -6, -3, 0, 3, 6 };
+    return values;
+}
+
+void OffsetCalibrator::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (enabled_ == enabled) return;
+    enabled_.store(enabled);
+    ports_.clear();
+    trials_.clear();
+    log(std::string("---- [偏移标定] ") + (enabled ? "进入标定模式" : "退出标定模式"));
+}
+
+OffsetCalibrator::PortStats& OffsetCalibrator::statsFor(int portID)
+{
+    auto& stats = ports_[portID];
+    if (stats.candidates.empty()) stats.candidates.resize(deltas().size());
+    return stats;
+}
+
+int OffsetCalibrator::deltaFor(int portID)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!enabled_) return 0;
+    return deltas()[statsFor(portID).next];
+}
+
+void OffsetCalibrator::onUnload(int carID, int portID, clock::time_point when)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!enabled_) return;
+    auto& stats = statsFor(portID);
+    trials_[carID] = { portID, stats.next, when };
+    stats.next = (stats.next + 1) % stats.candidates.size();       //下一次换下一个候选
+}
+
+void OffsetCalibrator::onCargoDetected(int carID)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = trials_.find(carID);
+    if (it == trials_.end()) return;
+    ++statsFor(it->second.portID).candidates[it->second.candidate].failure;
+    trials_.erase(it);
+}
+
+void OffsetCalibrator::collect(clock::time_point now, clock::duration revolution,
+                               const std::unordered_map<int, int>& baseOffset, std::vector<Learned>& learned)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!enabled_) return;
+    for (auto it = trials_.begin(); it != trials_.end();)
+    {
+        if (now - it->second.when < revolution) {
+            ++it;
+            continue;
+        }
+        ++statsFor(it->second.portID).candidates[it->second.candidate].success;
+        it = trials_.erase(it);
+    }
+    for (auto it = ports_.begin(); it != ports_.end();)
+    {
+        const auto& candidates = it->second.candidates;
+        bool complete = true;
+        for (const auto& c : candidates)
+        {
+            if (c.success + c.failure < TrialsPerCandidate) {
+                complete = false;
+                break;
+            }
+        }
+        auto base = baseOffset.find(it->first);
+        if (!complete || base == baseOffset.end()) {
+            ++it;
+            continue;
+        }
+        int sum = 0, count = 0;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            double rate = static_cast<double>(candidates[i].success) / (candidates[i].success + candidates[i].failure);
+            if (rate < MinSuccessRate) continue;
+            sum += deltas()[i];
+            ++count;
+        }
+        if (count > 0) {
+            int delta = static_cast<int>(std::lround(static_cast<double>(sum) / count));   //成功区间的中点
+            learned.push_back({ it->first, base->second, base->second + delta });
+        }
+        else {
+            log("---- [偏移标定] 格口 [" + std::to_string(it->first) + "] 所有候选偏移成功率均不足, 保持原偏移量");
+        }
+        it = ports_.erase(it);          //重新开始下一轮标定
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef OFFSETCALIBRATOR_H
+#define OFFSETCALIBRATOR_H
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include "logger.h"
+
+// 格口偏移量自动标定: 标定模式下每个格口轮流在当前偏移量上加减若干毫秒下件,
+// 下件后一圈内空车光电检测到该车仍有货视为失败, 超过一圈未检测到视为成功.
+// 每个候选偏移都达到足够次数后, 取成功率达标的候选的平均值作为新偏移量
+class OffsetCalibrator {
+public:
+    using clock = std::chrono::steady_clock;
+    struct Learned {
+        int portID;
+        int oldOffset;
+        int newOffset;
+    };
+
+    void setEnabled(bool enabled);
+    bool enabled() const { return enabled_.load(); }
+    int deltaFor(int portID);                                       //本格口下一次下件使用的偏移修正(ms)
+    void onUnload(int carID, int portID, clock::time_point when);   //下件命令已发出, 开始一次试验
+    void onCargoDetected(int carID);                                //空车光电检测到有货
+    // 超过一圈未检测到有货的试验记为成功; 达到次数的格口输出标定结果, baseOffset 为当前配置偏移量
+    void collect(clock::time_point now, clock::duration revolution,
+                 const std::unordered_map<int, int>& baseOffset, std::vector<Learned>& learned);
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    struct Candidate {
+        int success = 0;
+        int failure = 0;
+    };
+    struct PortStats {
+        size_t next = 0;                //下一次使用的候选序号
+        std::vector<Candidate> candidates;
+    };
+    struct Trial {
+        int portID;
+        size_t candidate;
+        clock::time_point when;
+    };
+
+    PortStats& statsFor(int portID);    //持锁调用
+
+    static const std::vector<int>& deltas();
+    static constexpr int TrialsPerCandidate = 5;
+    static constexpr double MinSuccessRate = 0.8;
+
+    std::mutex mtx_;
+    std::atomic<bool> enabled_{ false };
+    std::unordered_map<int, PortStats> ports_;
+    std::unordered_map<int, Trial> trials_;     //小车号 -> 进行中的试验
+};
+
+#endif // OFFSETCALIBRATOR_H
@@ -53,6 +53,8 @@ public:
 
     void DisconnectFromPLC();
 
+    bool IsConnected() { return client.Connected(); }
+
     // -------------- 新增：读取整型（1/2/4 字节） --------------
     // 返回 true 表示读取成功并将结果写入 outValue；false 表示失败
     template <typename T>
@@ -152,6 +154,23 @@ public:
         return true;
     }
 
+    // 格口数量可配置, 按位读取到 vector 中 (下标 0 对应第 1 个格口)
+    bool ReadBools_Vector(int dbNumber, int startByte, int count, std::vector<bool>& outBits)
+    {
+        size_t COUNT = count;
+        size_t BYTES = (COUNT + 7) / 8;
+        std::vector<uint8_t> buffer(BYTES);
+
+        int result = client.DBRead(dbNumber, startByte, static_cast<int>(BYTES), buffer.data());
+        if (result != 0) return false;
+
+        outBits.assign(COUNT, false);
+        for (size_t i = 0; i < COUNT; ++i) {
+            outBits[i] = ((buffer[i / 8] >> (i % 8)) & 0x1) != 0;    // LSB=0
+        }
+        return true;
+    }
+
 private:
 
     TS7Client client;
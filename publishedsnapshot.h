@@ -0,0 +1,34 @@
+#ifndef PUBLISHEDSNAPSHOT_H
+#define PUBLISHEDSNAPSHOT_H
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+// 发布/读取不可变快照 (RCU 方式): 写线程构造新版本后整体替换指针,
+// 读线程拿到 shared_ptr 后无需加锁, 旧版本在最后一个读者释放后自动回收
+template <typename T>
+class PublishedSnapshot {
+public:
+    using Ptr = std::shared_ptr<const T>;
+
+    PublishedSnapshot() : current_(std::make_shared<const T>()) {}
+    PublishedSnapshot(const PublishedSnapshot&) = delete;
+    PublishedSnapshot& operator=(const PublishedSnapshot&) = delete;
+
+    Ptr load() const
+    {
+        return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+    }
+    void publish(Ptr next)
+    {
+        std::atomic_store_explicit(&current_, std::move(next), std::memory_order_release);
+        version_.fetch_add(1, std::memory_order_release);
+    }
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+private:
+    Ptr current_;
+    std::atomic<uint64_t> version_{ 0 };
+};
+
+#endif // PUBLISHEDSNAPSHOT_H
@@ -0,0 +1,242 @@
+#include "scannerstation.h"
+#include <algorithm>
+#include <cstring>
+#include "sqlconnectionpool.h"
+#include "socketreactor.h"
+
+std::vector<ScannerStationConfig> ScannerStationConfig::load()
+{
+    std::vector<ScannerStationConfig> stations;
+    auto _sqlQuery = SqlConnectionPool::instance().acquire();
+    if (!_sqlQuery) {
+        Logger::getInstance().Log("----[sql异常] 扫码站配置 连接是空指针!");
+        return stations;
+    }
+    try
+    {
+        auto rows = _sqlQuery->readTable("scanner_station_config");
+        for (const auto& row : rows)
+        {
+            if (row.size() < 5) continue;
+            ScannerStationConfig cfg;
+            cfg.id = std::stoi(row[0]);
+            cfg.name = row[1].empty() ? "扫码站" + row[0] : row[1];
+            cfg.ip = row[2];
+            cfg.receivePort = std::stoi(row[3]);
+            cfg.position = std::stoi(row[4]);
+            if (row.size() > 6 && !row[6].empty()) {
+                cfg.carIdIp = row[5];
+                cfg.carIdPort = std::stoi(row[6]);
+            }
+            if (row.size() > 7 && !row[7].empty()) cfg.parser = row[7];
+            stations.push_back(cfg);
+        }
+        if (!stations.empty()) return stations;
+
+        //未配置扫码站表, 沿用 41/42 两台相机的配置项
+        struct Legacy { const char* suffix; const char* name; const char* ip; int port; int position; const char* parser; };
+        const Legacy legacy[] = {
+            { "one", "41相机", "192.168.93.41", 2015, 80, "csv:2" },
+            { "two", "42相机", "192.168.93.42", 2012, 113, "raw" },
+        };
+        int id = 0;
+        for (const auto& l : legacy)
+        {
+            std::string suffix = l.suffix;
+            ScannerStationConfig cfg;
+            cfg.id = ++id;
+            cfg.name = l.name;
+            cfg.parser = l.parser;
+            auto ip = _sqlQuery->queryString("config", "name", "camera_ip_" + suffix, "value");
+            auto port = _sqlQuery->queryString("config", "name", "camera_receive_" + suffix, "value");
+            auto position = _sqlQuery->queryString("config", "name", "camera_position_" + suffix, "value");
+            auto carIdIp = _sqlQuery->queryString("config", "name", "camera_carid_ip_" + suffix, "value");
+            auto carIdPort = _sqlQuery->queryString("config", "name", "camera_carid_port_" + suffix, "value");
+            cfg.ip = ip && !ip->empty() ? *ip : l.ip;
+            cfg.receivePort = port && std::stoi(*port) > 0 ? std::stoi(*port) : l.port;
+            cfg.position = position ? std::stoi(*position) : l.position;
+            if (carIdIp && carIdPort) {
+                cfg.carIdIp = *carIdIp;
+                cfg.carIdPort = std::stoi(*carIdPort);
+            }
+            stations.push_back(cfg);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        Logger::getInstance().Log("---- [扫码站] 读取配置异常: " + std::string(e.what()));
+    }
+    return stations;
+}
+
+WaybillParser WaybillParser::fromSpec(const std::string& spec)
+{
+    WaybillParser parser;
+    size_t pos = 0;
+    while (pos <= spec.size())
+    {
+        size_t next = spec.find(';', pos);
+        std::string token = spec.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+        if (token.compare(0, 4, "csv:") == 0) parser.field_ = std::max(0, std::atoi(token.c_str() + 4));
+        else if (token.compare(0, 4, "car:") == 0) parser.carField_ = std::max(0, std::atoi(token.c_str() + 4));
+        if (next == std::string::npos) break;
+        pos = next + 1;
+    }
+    return parser;
+}
+
+std::string WaybillParser::spec() const
+{
+    std::string text = field_ == 0 ? "raw" : "csv:" + std::to_string(field_);
+    if (carField_ > 0) text += ";car:" + std::to_string(carField_);
+    return text;
+}
+
+bool WaybillParser::fieldAt(const char* data, size_t len, int n, const char*& start, size_t& fieldLen)
+{
+    const char* begin = data;
+    const char* end = data + len;
+    for (int i = 1; i < n; ++i)
+    {
+        const char* comma = static_cast<const char*>(std::memchr(begin, ',', end - begin));
+        if (!comma) return false;
+        begin = comma + 1;
+    }
+    const char* comma = static_cast<const char*>(std::memchr(begin, ',', end - begin));
+    start = begin;
+    fieldLen = static_cast<size_t>((comma ? comma : end) - begin);
+    return true;
+}
+
+WaybillParser::Result WaybillParser::parse(const char* data, size_t len, WaybillCode& out, int* carID) const
+{
+    static const char noRead[] = "NoRead";
+    if (carID)
+    {
+        *carID = 0;
+        const char* s = nullptr;
+        size_t n = 0;
+        if (carField_ > 0 && fieldAt(data, len, carField_, s, n) && n > 0 && n < 8)
+        {
+            int value = 0;
+            for (size_t i = 0; i < n && value >= 0; ++i) value = (s[i] >= '0' && s[i] <= '9') ? value * 10 + (s[i] - '0') : -1;
+            if (value > 0) *carID = value;
+        }
+    }
+    const char* start = data;
+    size_t n = len;
+    if (field_ > 0 && !fieldAt(data, len, field_, start, n)) {
+        out.clear();
+        return Result::NoRead;      //字段不足视为未读到
+    }
+    if (n == 0 || (n == sizeof(noRead) - 1 && std::memcmp(start, noRead, n) == 0)) {
+        out.clear();
+        return Result::NoRead;
+    }
+    if (!WaybillCode::fits(n)) {
+        out.assign(start, n);           //截断后仅用于日志
+        return Result::TooLong;
+    }
+    out.assign(start, n);
+    return Result::Ok;
+}
+
+ScannerStation::ScannerStation(int index, const ScannerStationConfig& config, char delimiter, size_t queueCapacity)
+    : index_(index), config_(config), parser_(WaybillParser::fromSpec(config.parser)),
+      framer_(delimiter != '\0' ? MessageFramer::delimited(delimiter) : MessageFramer::chunk()),
+      capacity_(queueCapacity)
+{
+}
+
+ScannerStation::~ScannerStation()
+{
+    stop();
+}
+
+bool ScannerStation::connect()
+{
+    //相机数据在统一接收线程中分帧, 完整的一帧放入本站队列, 半帧留在接收缓冲中
+    connection_.client.setReceiveHandler([this](const char* data, size_t len) {
+        uint64_t errors = framer_.errors();
+        auto readAt = SocketReactor::readTime();
+        size_t consumed = framer_.feed(data, len, [this, readAt](const char* frame, size_t n) {
+            enqueue(frame, n, readAt);
+            return true;
+        });
+        if (framer_.errors() != errors) log("---- [" + name() + "] 分帧错误, " + framer_.summary());
+        return consumed;
+    });
+    bool ok = connection_.connectTo(config_.ip, config_.receivePort);
+    log("---- [" + name() + "] 接收端口 " + config_.ip + ":" + std::to_string(config_.receivePort) + (ok ? " 连接成功!" : " 连接失败!")
+        + " 位置: [" + std::to_string(config_.position) + "], 解析: [" + parser_.spec() + "]");
+    return ok;
+}
+
+void ScannerStation::enqueue(const char* data, size_t len, clock::time_point readAt)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        ++received_;
+        if (queue_.size() >= capacity_) {   //处理线程跟不上, 丢弃本帧; 后续回传按时间重新匹配触发
+            ++dropped_;
+            log("---- [" + name() + "] 接收队列已满, 丢弃一帧!");
+            return;
+        }
+        queue_.push_back(Frame{ std::string(data, len), readAt });
+    }
+    cv_.notify_one();
+}
+
+void ScannerStation::start(Handler handler)
+{
+    if (worker_.joinable()) return;
+    handler_ = std::move(handler);
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = false;
+    }
+    worker_ = std::thread(&ScannerStation::workerLoop, this);
+}
+
+void ScannerStation::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+    connection_.disconnect();
+}
+
+void ScannerStation::workerLoop()
+{
+    std::deque<Frame> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) break;
+            batch.swap(queue_);
+        }
+        for (const auto& frame : batch)
+        {
+            try
+            {
+                handler_(*this, frame);
+            }
+            catch (const std::exception& e)
+            {
+                log("---- [" + name() + "] 处理异常: " + std::string(e.what()));
+            }
+        }
+        batch.clear();
+    }
+}
+
+std::string ScannerStation::summary()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return "接收: [" + std::to_string(received_) + "], 丢弃: [" + std::to_string(dropped_) + "], 排队: [" + std::to_string(queue_.size()) + "]";
+}
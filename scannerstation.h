@@ -0,0 +1,103 @@
+#ifndef SCANNERSTATION_H
+#define SCANNERSTATION_H
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include "logger.h"
+#include "socketclinet.h"
+#include "messageframer.h"
+#include "waybillcode.h"
+
+// 扫码站(相机)配置, 来自 scanner_station_config 表; 表为空时按旧的 41/42 相机配置项生成两个站
+struct ScannerStationConfig {
+    int id = 0;
+    std::string name;
+    std::string ip;
+    int receivePort = 0;
+    int position = 0;               //相机位置: 经过车数 + position 即为相机下的小车
+    std::string carIdIp;            //发送小车号的地址, 空 = 不发送
+    int carIdPort = 0;
+    std::string parser = "raw";     //回传内容解析方式, 见 WaybillParser
+
+    // 表字段顺序: station_id, name, ip, receive_port, position, carid_ip, carid_port, parser
+    static std::vector<ScannerStationConfig> load();
+};
+
+// 相机回传内容 -> 面单号. "raw" = 整帧即面单号; "csv:N" = 第 N 个逗号分隔字段(从 1 开始).
+// 相机回传中带有下发的小车号时追加 ";car:M", 小车号取第 M 个逗号分隔字段, 如 "csv:2;car:3"
+class WaybillParser {
+public:
+    enum class Result { Ok, NoRead, TooLong };
+
+    static WaybillParser fromSpec(const std::string& spec);
+    // 直接切片, 不拆分成字符串数组; carID 非空时输出回传中的小车号, 没有或非法为 0
+    Result parse(const char* data, size_t len, WaybillCode& out, int* carID = nullptr) const;
+    bool hasCarField() const { return carField_ > 0; }
+    std::string spec() const;
+
+private:
+    static bool fieldAt(const char* data, size_t len, int n, const char*& start, size_t& fieldLen);   //第 n 个逗号分隔字段
+
+    int field_ = 0;
+    int carField_ = 0;
+};
+
+// 单个扫码站的接收与处理: 统一接收线程分帧后放入本站队列, 本站处理线程按到达顺序逐帧交给回调.
+// 各站互不阻塞, 增加扫码站只需增加配置
+class ScannerStation {
+public:
+    using clock = std::chrono::steady_clock;
+    struct Frame {
+        std::string data;
+        clock::time_point readAt;       //recv 返回时间, 用于匹配触发
+    };
+    using Handler = std::function<void(ScannerStation&, const Frame&)>;
+
+    ScannerStation(int index, const ScannerStationConfig& config, char delimiter, size_t queueCapacity = 256);
+    ~ScannerStation();
+    ScannerStation(const ScannerStation&) = delete;
+    ScannerStation& operator=(const ScannerStation&) = delete;
+
+    int index() const { return index_; }
+    const ScannerStationConfig& config() const { return config_; }
+    const std::string& name() const { return config_.name; }
+    const WaybillParser& parser() const { return parser_; }
+    SocketConnection& connection() { return connection_; }
+
+    bool connect();                     //设置分帧后连接相机接收端口
+    void start(Handler handler);
+    void stop();                        //停止处理线程并断开连接
+    std::string summary();
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    void enqueue(const char* data, size_t len, clock::time_point readAt);     //接收线程调用
+    void workerLoop();
+
+    int index_;
+    ScannerStationConfig config_;
+    WaybillParser parser_;
+    SocketConnection connection_;
+    MessageFramer framer_;
+    Handler handler_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Frame> queue_;
+    size_t capacity_;
+    bool stopping_ = false;
+    std::thread worker_;
+    uint64_t received_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+#endif // SCANNERSTATION_H
@@ -0,0 +1,185 @@
+#include "serialdrivepipeline.h"
+#include <cstdio>
+
+SerialDrivePipeline::SerialDrivePipeline(int socketCount, size_t laneCapacity)
+    : laneCapacity_(laneCapacity)
+{
+    lanes_.reserve(socketCount);
+    for (int i = 0; i < socketCount; ++i)
+    {
+        auto lane = std::make_unique<Lane>();
+        lane->queue.reserve(laneCapacity_);
+        lane->sending.reserve(laneCapacity_);
+        lane->buffer.reserve(laneCapacity_ * sizeof(DriveFrame));
+        lanes_.push_back(std::move(lane));
+    }
+}
+
+SerialDrivePipeline::~SerialDrivePipeline()
+{
+    stop();
+}
+
+void SerialDrivePipeline::setSocket(int index, SocketClient* client)
+{
+    if (index < 0 || index >= static_cast<int>(lanes_.size())) return;
+    std::lock_guard<std::mutex> lk(lanes_[index]->mtx);
+    lanes_[index]->sockets[0] = client;
+}
+
+void SerialDrivePipeline::setStandbySocket(int index, SocketClient* client)
+{
+    if (index < 0 || index >= static_cast<int>(lanes_.size())) return;
+    std::lock_guard<std::mutex> lk(lanes_[index]->mtx);
+    lanes_[index]->sockets[1] = client;
+}
+
+bool SerialDrivePipeline::usingStandby(int index) const
+{
+    if (index < 0 || index >= static_cast<int>(lanes_.size())) return false;
+    std::lock_guard<std::mutex> lk(lanes_[index]->mtx);
+    return lanes_[index]->active == 1;
+}
+
+bool SerialDrivePipeline::failover(int index, const std::string& reason)
+{
+    Lane& lane = *lanes_[index];
+    std::lock_guard<std::mutex> lk(lane.mtx);
+    int other = 1 - lane.active;
+    if (!linkUp(lane.sockets[other])) {
+        log("---- [串口切换] 第 [" + std::to_string(index + 1) + "] 组" + reason + ", 但" + (other == 1 ? "备用" : "主") + "连接不可用!");
+        return false;
+    }
+    lane.active = other;
+    log("---- [串口切换] 第 [" + std::to_string(index + 1) + "] 组" + reason + ", 切换到" + (other == 1 ? "备用" : "主") + "连接");
+    return true;
+}
+
+void SerialDrivePipeline::healthCheck()
+{
+    for (int i = 0; i < static_cast<int>(lanes_.size()); ++i)
+    {
+        bool activeDown = false;
+        {
+            std::lock_guard<std::mutex> lk(lanes_[i]->mtx);
+            activeDown = !linkUp(lanes_[i]->sockets[lanes_[i]->active]);
+        }
+        if (activeDown) failover(i, "当前连接断开");
+    }
+}
+
+void SerialDrivePipeline::start()
+{
+    stopping_.store(false);
+    for (int i = 0; i < static_cast<int>(lanes_.size()); ++i)
+    {
+        if (lanes_[i]->worker.joinable()) continue;
+        lanes_[i]->worker = std::thread(&SerialDrivePipeline::laneLoop, this, i);
+    }
+    log("---- [串口发送] 启动 [" + std::to_string(lanes_.size()) + "] 个发送线程");
+}
+
+void SerialDrivePipeline::stop()
+{
+    for (auto& lane : lanes_)
+    {
+        {
+            std::lock_guard<std::mutex> lk(lane->mtx);
+            stopping_.store(true);
+        }
+        lane->cv.notify_all();
+    }
+    for (auto& lane : lanes_)
+    {
+        if (lane->worker.joinable()) lane->worker.join();
+    }
+}
+
+bool SerialDrivePipeline::submit(int index, const DriveCommand& cmd)
+{
+    if (index < 0 || index >= static_cast<int>(lanes_.size())) return false;
+    Lane& lane = *lanes_[index];
+    {
+        std::lock_guard<std::mutex> lk(lane.mtx);
+        if (!linkUp(lane.sockets[0]) && !linkUp(lane.sockets[1])) return false;
+        if (lane.queue.size() >= laneCapacity_) return false;      //发送线程积压, 不再排队
+        lane.queue.push_back(cmd);
+    }
+    lane.cv.notify_one();
+    return true;
+}
+
+void SerialDrivePipeline::laneLoop(int index)
+{
+    Lane& lane = *lanes_[index];
+    while (true)
+    {
+        SocketClient* socket = nullptr;
+        {
+            std::unique_lock<std::mutex> lk(lane.mtx);
+            auto ready = [&] { return stopping_.load() || !lane.queue.empty(); };
+            if (ackTracker_ && ackTracker_->hasOutstanding(index)) {
+                lane.cv.wait_for(lk, ackPollInterval, ready);   //等待回码期间定时检查超时
+            }
+            else {
+                lane.cv.wait(lk, ready);
+            }
+            if (stopping_.load()) break;
+            lane.sending.clear();
+            std::swap(lane.sending, lane.queue);    //取出本批次, 容量随交换保留
+        }
+        if (ackTracker_ && ackTracker_->collectTimeouts(index, std::chrono::steady_clock::now(), lane.sending) > 0) {
+            int threshold = failoverAfterLost_.load();
+            if (threshold > 0 && ackTracker_->consecutiveLost(index) >= threshold) {     //单条丢失不切换, 连续丢失才认为当前连接不再回码
+                ackTracker_->resetLost(index);
+                failover(index, "连续 [" + std::to_string(threshold) + "] 条命令回码丢失");
+            }
+        }
+        if (lane.sending.empty()) continue;
+
+        lane.buffer.clear();
+        for (const auto& cmd : lane.sending)
+        {
+            lane.buffer.insert(lane.buffer.end(), cmd.frame.begin(), cmd.frame.end());
+        }
+        {
+            std::lock_guard<std::mutex> lk(lane.mtx);
+            socket = lane.sockets[lane.active].data();
+        }
+        auto sentAt = std::chrono::steady_clock::now();
+        if (ackTracker_) {          //先登记整批命令再发送, 回码先于登记到达会被当作无匹配
+            for (const auto& cmd : lane.sending) ackTracker_->onSent(index, cmd, sentAt);
+        }
+        bool ok = socket != nullptr && socket->SocketConnection && socket->sendRaw(lane.buffer.data(), static_cast<int>(lane.buffer.size()));
+        if (!ok && failover(index, "发送失败"))       //同一批次立即从另一连接重发
+        {
+            {
+                std::lock_guard<std::mutex> lk(lane.mtx);
+                socket = lane.sockets[lane.active].data();
+            }
+            ok = socket != nullptr && socket->sendRaw(lane.buffer.data(), static_cast<int>(lane.buffer.size()));
+        }
+        if (!ok && ackTracker_) {   //主备都发送失败, 撤销登记
+            for (const auto& cmd : lane.sending) ackTracker_->onDropped(index, cmd);
+        }
+        for (const auto& cmd : lane.sending)       //日志放在发送与登记之后
+        {
+            if (ok) {
+                log("---- [命令帧] 发送: [" + frameHex(cmd.frame) + "] 至第 [" + std::to_string(index + 1) + "] 个TCP端口, [" + std::to_string(cmd.carID) + "] 小车运动! seq: [" + std::to_string(cmd.seq) + "]");
+            }
+            else {
+                log("---- [错误] 命令帧发送失败: [" + frameHex(cmd.frame) + "] 第 [" + std::to_string(index + 1) + "] 个TCP端口, 小车: [" + std::to_string(cmd.carID) + "]");
+            }
+        }
+    }
+}
+
+std::string SerialDrivePipeline::frameHex(const DriveFrame& frame)
+{
+    char text[sizeof(DriveFrame) * 3] = { 0 };
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+        std::snprintf(text + i * 3, 4, i + 1 < frame.size() ? "%02X " : "%02X", frame[i]);
+    }
+    return std::string(text);
+}
@@ -0,0 +1,67 @@
+#ifndef SERIALDRIVEPIPELINE_H
+#define SERIALDRIVEPIPELINE_H
+#include <array>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <QPointer>
+#include "socketclinet.h"
+#include "logger.h"
+#include "driveacktracker.h"
+
+// 串口服务器发送流水线: 每个串口服务器一个提交队列 + 一个发送线程,
+// 同一时刻排队的多帧合并为一次 send(), 某个串口服务器阻塞不影响其他服务器和下件调度.
+// 每组小车有主/备两个连接, 发送失败时切换到另一个连接并立即重发; 连续多条命令未回码时才按回码丢失切换(默认关闭)
+class SerialDrivePipeline {
+public:
+    explicit SerialDrivePipeline(int socketCount, size_t laneCapacity = 64);
+    ~SerialDrivePipeline();
+
+    SerialDrivePipeline(const SerialDrivePipeline&) = delete;
+    SerialDrivePipeline& operator=(const SerialDrivePipeline&) = delete;
+
+    void setSocket(int index, SocketClient* client);
+    void setStandbySocket(int index, SocketClient* client);
+    void healthCheck();     //当前连接断开而另一连接正常时切换
+    bool usingStandby(int index) const;
+    void setAckTracker(DriveAckTracker* tracker) { ackTracker_ = tracker; }    //启动前设置, 发送后登记并负责超时重发
+    // 连续放弃多少条命令后切换连接, 0 = 不因回码丢失切换(回码格式确认前保持关闭)
+    void setFailoverAfterLost(int count) { failoverAfterLost_.store(count); }
+    bool submit(int index, const DriveCommand& cmd);    //非阻塞提交, 队列满或未连接返回 false
+    void start();
+    void stop();
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    struct Lane {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<DriveCommand> queue;        //提交队列, 预分配容量
+        std::vector<DriveCommand> sending;      //发送线程取出的批次, 与 queue 交换
+        std::vector<char> buffer;               //合并后的发送缓冲
+        QPointer<SocketClient> sockets[2];      //0 = 主连接, 1 = 备用连接
+        int active = 0;
+        std::thread worker;
+    };
+
+    void laneLoop(int index);
+    bool failover(int index, const std::string& reason);    //切换到另一个已连接的连接, 无可用连接返回 false
+    static bool linkUp(const QPointer<SocketClient>& socket) { return !socket.isNull() && socket->SocketConnection; }
+    static std::string frameHex(const DriveFrame& frame);
+
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    size_t laneCapacity_;
+    DriveAckTracker* ackTracker_ = nullptr;
+    std::atomic<int> failoverAfterLost_{ 0 };
+    static constexpr std::chrono::milliseconds ackPollInterval{ 1 };   //有未回码命令时的检查周期
+    std::atomic<bool> stopping_{ false };
+};
+
+#endif // SERIALDRIVEPIPELINE_H
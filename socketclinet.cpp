@@ -1,8 +1,8 @@
 #include "socketclinet.h"
 #include<WinSock2.h>
 #include<WS2tcpip.h>
-#include<thread>
 #include"logger.h"
+#include"socketreactor.h"
 #pragma comment(lib,"ws2_32.lib")
 
 SOCKET SocketClient::ConnectTo(const std::string& ip, int port, bool receivce) {
@@ -10,6 +10,7 @@ SOCKET SocketClient::ConnectTo(const std::string& ip, int port, bool receivce) {
     SOCKET clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     ipAddress = ip;
     mPort = port;
+    receiveEnabled = receivce;
 
     if (clientSocket == INVALID_SOCKET) {
         Logger::getInstance().Log("---- [Error] Port: [" + std::to_string(port) + "] Create socket failed：" + std::to_string(WSAGetLastError()));
@@ -23,6 +24,9 @@ SOCKET SocketClient::ConnectTo(const std::string& ip, int port, bool receivce) {
         return INVALID_SOCKET;
     }
 
+    BOOL keepAlive = TRUE;      // 及时发现对端掉线, 交给连接守护重连
+    setsockopt(clientSocket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&keepAlive), sizeof(keepAlive));
+
     sockaddr_in serverAddr;
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_port = htons(port);
@@ -40,7 +44,14 @@ SOCKET SocketClient::ConnectTo(const std::string& ip, int port, bool receivce) {
     }
     else
     {
-        mSock = clientSocket;  // 保存连接的套接字
+        if (nonBlockingSend) {     // 连接建立后再切换为非阻塞, 连接过程仍按阻塞方式
+            u_long mode = 1;
+            ioctlsocket(clientSocket, FIONBIO, &mode);
+        }
+        {
+            std::lock_guard<std::mutex> lk(sockMtx);
+            mSock = clientSocket;  // 保存连接的套接字
+        }
         SocketConnection = true;
         if (receivce) {		// 是否启动接收线程
             startReceiveData(clientSocket);  // 启动接收数据线程
@@ -53,6 +64,7 @@ bool SocketClient::sendData(SOCKET sock, const std::string& message)
 {
     try
     {
+        std::lock_guard<std::mutex> lk(sockMtx);
         int result = send(sock, message.c_str(), message.length(), 0);
         if (result == SOCKET_ERROR)
         {
@@ -72,52 +84,86 @@ bool SocketClient::sendData(SOCKET sock, const std::string& message)
     return false;
 }
 
-void SocketClient::receiveData(SOCKET sock) {
-
-    char buffer[1024];
-    int result;
-    try
+bool SocketClient::sendRaw(const char* data, int len)
+{
+    std::lock_guard<std::mutex> lk(sockMtx);       //重连不会在发送中途关闭或替换 mSock
+    if (mSock == INVALID_SOCKET) return false;
+    int sent = 0;
+    while (sent < len)
     {
-        while (receiving)
+        int result = send(mSock, data + sent, len - sent, 0);
+        if (result == SOCKET_ERROR)
         {
-            result = recv(sock, buffer, sizeof(buffer), 0);
-            if (result > 0)
-            {
-                int len = std::min(result, static_cast<int>(sizeof(buffer) - 1));
-                buffer[len] = '\0';
-                QByteArray ba(buffer, result);
-                emit dataReceived(ba);
-            }
-            else if (result == 0) {
-                Logger::getInstance().Log("---- [Error] IP: [" + ipAddress + "]. Port: [" + std::to_string(mPort) + "]. Socket disconnected!");
-                SocketConnection = false;
-                break;
-            }
-            else {
-                //Logger::getInstance().Log("---- [Error] IP: [" + ipAddress + "]. Port: [" + std::to_string(mPort) + "]. Socket failed to receive data: " + std::to_string(WSAGetLastError()));
-                //SocketConnection = false;
-                // break;
-            }
+            Logger::getInstance().Log("---- [Error] IP: [" + ipAddress + "]. Port: [" + std::to_string(mPort) + "]. Socket failed to send raw data: " + std::to_string(WSAGetLastError()));
+            SocketConnection = false;
+            return false;
         }
+        sent += result;
+    }
+    return true;
+}
 
+bool SocketClient::trySendRaw(const char* data, int len)
+{
+    std::lock_guard<std::mutex> lk(sockMtx);
+    if (mSock == INVALID_SOCKET) return false;
+    int result = send(mSock, data, len, 0);
+    if (result == len) return true;
+    if (result == SOCKET_ERROR)
+    {
+        int err = WSAGetLastError();
+        if (err == WSAEWOULDBLOCK) return false;        //对端未读取, 发送缓冲已满, 丢弃本帧
+        Logger::getInstance().Log("---- [Error] IP: [" + ipAddress + "]. Port: [" + std::to_string(mPort) + "]. Socket failed to send raw data: " + std::to_string(err));
+        SocketConnection = false;
+        return false;
+    }
+    Logger::getInstance().Log("---- [Error] IP: [" + ipAddress + "]. Port: [" + std::to_string(mPort) + "]. Partial send [" + std::to_string(result) + "/" + std::to_string(len) + "], reconnect!");
+    SocketConnection = false;       //剩余字节无法补发, 断开重连以免后续帧错位
+    return false;
+}
+
+size_t SocketClient::onReactorData(const char* data, size_t len)
+{
+    try
+    {
+        if (receiveHandler) return receiveHandler(data, len);
+        emit dataReceived(QByteArray(data, static_cast<int>(len)));
     }
     catch (const std::exception& ex)
     {
-        Logger::getInstance().Log(std::string("---- [Error] handleSupplyWorking exception: ") + ex.what());
+        Logger::getInstance().Log(std::string("---- [Error] IP: [" + ipAddress + "] receive handler exception: ") + ex.what());
     }
+    return len;
 }
 
 void SocketClient::startReceiveData(SOCKET sock) {
-    receiving.store(true);  // 保证循环能跑起来
-    receiveThread = std::thread(&SocketClient::receiveData, this, sock);
-    receiveThread.detach();  // 放掉线程，让它自己跑
+    receiving.store(true);
+    SocketReactor::instance().add(sock,
+        [this](const char* data, size_t len) { return onReactorData(data, len); },
+        [this]() {
+            Logger::getInstance().Log("---- [Error] IP: [" + ipAddress + "]. Port: [" + std::to_string(mPort) + "]. Socket disconnected!");
+            SocketConnection = false;
+            receiving.store(false);
+        });
 }
 
 void SocketClient::stopReceiveData() {
     SocketConnection = false;
-    receiving.store(false);
-    if (receiveThread.joinable()) {
-        receiveThread.join();
+    if (receiving.exchange(false)) {
+        SocketReactor::instance().remove(mSock);    //同步移除, 返回后不会再回调
     }
 }
 
+bool SocketClient::reconnect()
+{
+    if (ipAddress.empty()) return false;
+    stopReceiveData();
+    {
+        std::lock_guard<std::mutex> lk(sockMtx);   //等待正在进行的发送结束后再关闭, 连接过程不持锁
+        if (mSock != INVALID_SOCKET) {
+            closesocket(mSock);
+            mSock = INVALID_SOCKET;
+        }
+    }
+    return ConnectTo(ipAddress, mPort, receiveEnabled) != INVALID_SOCKET;
+}
@@ -4,7 +4,8 @@
 #include <WinSock2.h>
 #include <QObject>
 #include <atomic>
-#include <thread>
+#include <functional>
+#include <mutex>
 class SocketClient :public QObject{
 
     Q_OBJECT
@@ -16,32 +17,38 @@ public:
 
     bool sendData(SOCKET sock, const std::string& message);
 
+    bool sendRaw(const char* data, int len);    //发送原始字节, 处理部分发送
+
+    // 非阻塞发送: 发送缓冲满(WSAEWOULDBLOCK)立即返回 false, 不等待对端读取; 只发出部分字节时断开交给连接守护重连, 避免帧错位.
+    // 需在 ConnectTo 之前调用 setNonBlockingSend(true), 重连时沿用
+    bool trySendRaw(const char* data, int len);
+    void setNonBlockingSend(bool enable) { nonBlockingSend = enable; }
+
     void startReceiveData(SOCKET sock);
 
     void stopReceiveData();
 
-    bool SocketConnection = false;
+    bool reconnect();       //关闭旧连接, 按上次的地址端口重新连接(由连接守护调用); 与发送互斥, 不会关闭正在发送的套接字
 
-public slots:
+    // 在接收线程中直接处理数据(不构造 QByteArray), 返回已处理的字节数; 需在 ConnectTo 之前设置
+    void setReceiveHandler(std::function<size_t(const char*, size_t)> handler) { receiveHandler = std::move(handler); }
+
+    std::atomic<bool> SocketConnection{ false };
 
-    void sendComand(int socketIndex, const QByteArray& command) {
-        if (SocketConnection)
-        {
-            Q_UNUSED(socketIndex);
-            bool ok = sendData(mSock, command.toStdString());
-        }
-    }
 signals:
 
     void dataReceived(const QByteArray& data);
 
 private:
 
-    void receiveData(SOCKET sock);
-    std::thread receiveThread;
-    std::atomic<bool> receiving{ false }; // class member: replace bool receiving
+    size_t onReactorData(const char* data, size_t len);
+    std::function<size_t(const char*, size_t)> receiveHandler;
+    std::atomic<bool> receiving{ false }; // 是否已注册到统一接收线程
     std::string ipAddress;
-    int mPort;
+    int mPort = 0;
+    bool receiveEnabled = true;     // ConnectTo 时是否启动接收, 重连时沿用
+    bool nonBlockingSend = false;   // ConnectTo 成功后设置为非阻塞套接字, 重连时沿用
+    std::mutex sockMtx;             // 发送线程与连接守护之间保护 mSock 的关闭与替换
 };
 
 struct SocketConnection
@@ -49,9 +56,9 @@ struct SocketConnection
     SocketClient client;
     SOCKET sock = INVALID_SOCKET;
     bool isConnected = false;
-    bool connectTo(const std::string& ip, int port)
+    bool connectTo(const std::string& ip, int port, bool receive = true)
     {
-        sock = client.ConnectTo(ip, port);
+        sock = client.ConnectTo(ip, port, receive);
         isConnected = (sock != INVALID_SOCKET);
         return isConnected;
     }
@@ -65,6 +72,12 @@ struct SocketConnection
             isConnected = false;
         }
     }
+    bool reconnect()
+    {
+        isConnected = client.reconnect();
+        sock = client.mSock;
+        return isConnected;
+    }
     bool send(const std::string& msg)
     {
         if (client.SocketConnection)
@@ -0,0 +1,134 @@
+#include "socketreactor.h"
+#include <cstring>
+#include <chrono>
+
+namespace {
+thread_local std::chrono::steady_clock::time_point tlsReadTime;
+}
+
+std::chrono::steady_clock::time_point SocketReactor::readTime()
+{
+    return tlsReadTime;
+}
+
+SocketReactor& SocketReactor::instance()
+{
+    static SocketReactor reactor;
+    return reactor;
+}
+
+SocketReactor::~SocketReactor()
+{
+    stop();
+}
+
+bool SocketReactor::add(SOCKET sock, DataHandler onData, CloseHandler onClose)
+{
+    if (sock == INVALID_SOCKET) return false;
+    auto conn = std::make_shared<Connection>();
+    conn->sock = sock;
+    conn->onData = std::move(onData);
+    conn->onClose = std::move(onClose);
+    {
+        std::lock_guard<std::recursive_mutex> lk(mtx_);
+        conns_[sock] = std::move(conn);
+        dirty_.store(true);
+        if (!running_.load()) {
+            if (worker_.joinable()) worker_.join();
+            running_.store(true);
+            worker_ = std::thread(&SocketReactor::loop, this);
+            log("---- [接收线程] 启动统一接收线程");
+        }
+    }
+    return true;
+}
+
+void SocketReactor::remove(SOCKET sock)
+{
+    std::lock_guard<std::recursive_mutex> lk(mtx_);     //反应器分发回调时持有该锁, 拿到锁即表示回调已结束
+    auto it = conns_.find(sock);
+    if (it == conns_.end()) return;
+    it->second->closed = true;
+    conns_.erase(it);
+    dirty_.store(true);
+}
+
+void SocketReactor::stop()
+{
+    running_.store(false);
+    if (worker_.joinable() && worker_.get_id() != std::this_thread::get_id()) worker_.join();
+}
+
+bool SocketReactor::readConnection(Connection& conn)
+{
+    if (conn.writePos == BufferSize) {
+        if (conn.readPos > 0) {             //整理缓冲, 把未消费数据移到开头
+            std::memmove(conn.buffer.get(), conn.buffer.get() + conn.readPos, conn.writePos - conn.readPos);
+            conn.writePos -= conn.readPos;
+            conn.readPos = 0;
+        }
+        else {                              //单条消息超过缓冲区, 丢弃
+            log("---- [接收线程] 连接 [" + std::to_string(conn.sock) + "] 接收缓冲已满, 丢弃 [" + std::to_string(conn.writePos) + "] 字节");
+            conn.writePos = 0;
+        }
+    }
+    int result = recv(conn.sock, conn.buffer.get() + conn.writePos, static_cast<int>(BufferSize - conn.writePos), 0);
+    tlsReadTime = std::chrono::steady_clock::now();
+    if (result == 0) return false;
+    if (result < 0) {
+        int err = WSAGetLastError();
+        return err == WSAEWOULDBLOCK || err == WSAEINTR;
+    }
+    conn.writePos += result;
+    size_t consumed = conn.onData ? conn.onData(conn.buffer.get() + conn.readPos, conn.writePos - conn.readPos) : conn.writePos - conn.readPos;
+    if (conn.closed) return true;           //回调中已移除
+    conn.readPos += consumed;
+    if (conn.readPos >= conn.writePos) {
+        conn.readPos = 0;
+        conn.writePos = 0;
+    }
+    return true;
+}
+
+void SocketReactor::loop()
+{
+    std::vector<WSAPOLLFD> fds;
+    std::vector<std::shared_ptr<Connection>> polled;
+    while (running_.load())
+    {
+        if (dirty_.exchange(false)) {       //连接变化, 重建 poll 列表
+            std::lock_guard<std::recursive_mutex> lk(mtx_);
+            fds.clear();
+            polled.clear();
+            for (auto& kv : conns_) {
+                WSAPOLLFD fd{};
+                fd.fd = kv.first;
+                fd.events = POLLRDNORM;
+                fds.push_back(fd);
+                polled.push_back(kv.second);
+            }
+        }
+        if (fds.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PollTimeoutMs));
+            continue;
+        }
+        int n = WSAPoll(fds.data(), static_cast<unsigned long>(fds.size()), PollTimeoutMs);
+        if (n <= 0) continue;
+
+        std::lock_guard<std::recursive_mutex> lk(mtx_);
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (fds[i].revents == 0) continue;
+            auto& conn = polled[i];
+            fds[i].revents = 0;
+            if (conn->closed) continue;
+            if (!readConnection(*conn)) {
+                conn->closed = true;
+                conns_.erase(conn->sock);
+                dirty_.store(true);
+                if (conn->onClose) conn->onClose();
+            }
+        }
+    }
+    log("---- [接收线程] 统一接收线程退出");
+}
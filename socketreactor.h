@@ -0,0 +1,61 @@
+#ifndef SOCKETREACTOR_H
+#define SOCKETREACTOR_H
+#include <WinSock2.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include "logger.h"
+
+// 单线程接收反应器: 所有 TCP 连接由一个线程 WSAPoll 统一读取, 取代每个连接一个 detach 的接收线程.
+// 每个连接有固定大小的接收环形缓冲, 回调在反应器线程中直接执行, 返回已消费的字节数, 未消费部分保留到下次
+class SocketReactor {
+public:
+    using DataHandler = std::function<size_t(const char* data, size_t len)>;
+    using CloseHandler = std::function<void()>;
+    static constexpr size_t BufferSize = 8192;
+
+    static SocketReactor& instance();
+
+    bool add(SOCKET sock, DataHandler onData, CloseHandler onClose);
+    void remove(SOCKET sock);   //返回后不会再调用该连接的回调
+    void stop();
+    // 当前回调对应数据的 recv 返回时间, 只在回调中有效; 用于步进等时间敏感信号, 不含后续处理延时
+    static std::chrono::steady_clock::time_point readTime();
+    void log(const std::string& msg)
+    {
+        Logger::getInstance().Log(msg);
+    }
+
+private:
+    SocketReactor() = default;
+    ~SocketReactor();
+    SocketReactor(const SocketReactor&) = delete;
+    SocketReactor& operator=(const SocketReactor&) = delete;
+
+    struct Connection {
+        SOCKET sock = INVALID_SOCKET;
+        DataHandler onData;
+        CloseHandler onClose;
+        std::unique_ptr<char[]> buffer{ new char[BufferSize] };
+        size_t readPos = 0;         //未消费数据起点
+        size_t writePos = 0;        //下一次 recv 写入位置
+        bool closed = false;
+    };
+
+    void loop();
+    bool readConnection(Connection& conn);      //返回 false 表示连接已断开
+
+    std::recursive_mutex mtx_;                  //回调中允许再次 add/remove
+    std::unordered_map<SOCKET, std::shared_ptr<Connection>> conns_;
+    std::atomic<bool> dirty_{ false };
+    std::atomic<bool> running_{ false };
+    std::thread worker_;
+    static constexpr int PollTimeoutMs = 10;    //轮询超时, 同时用于发现新增/移除的连接
+};
+
+#endif // SOCKETREACTOR_H
@@ -0,0 +1,78 @@
+#include "unloadscheduler.h"
+#include <thread>
+
+void UnloadScheduler::schedule(const Task& task)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    heap_.push(task);
+}
+
+void UnloadScheduler::clear()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    heap_ = decltype(heap_)();
+}
+
+void UnloadScheduler::notify()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        changed_ = true;
+    }
+    cv_.notify_one();
+}
+
+void UnloadScheduler::start()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    stopping_ = false;
+    changed_ = true;        //启动后先计算一次
+}
+
+void UnloadScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+}
+
+size_t UnloadScheduler::pending()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return heap_.size();
+}
+
+bool UnloadScheduler::waitDue(std::vector<Task>& due)
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (true)
+    {
+        if (stopping_) return false;
+        if (changed_) {                 //状态变化, 交给调用方重新计算
+            changed_ = false;
+            return true;
+        }
+        if (heap_.empty()) {
+            cv_.wait(lk, [this] { return stopping_ || changed_; });
+            continue;
+        }
+        auto deadline = heap_.top().deadline;
+        if (clock::now() + spinLead < deadline) {
+            cv_.wait_until(lk, deadline - spinLead, [this] { return stopping_ || changed_; });
+            continue;
+        }
+        lk.unlock();
+        while (clock::now() < deadline) {       //临近截止时间, 自旋
+            std::this_thread::yield();
+        }
+        lk.lock();
+        auto now = clock::now();
+        while (!heap_.empty() && heap_.top().deadline <= now) {
+            due.push_back(heap_.top());
+            heap_.pop();
+        }
+        if (!due.empty()) return true;
+    }
+}
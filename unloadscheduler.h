@@ -0,0 +1,44 @@
+#ifndef UNLOADSCHEDULER_H
+#define UNLOADSCHEDULER_H
+#include <chrono>
+#include <queue>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// 下件调度器: 按小车到达目标格口的时间点(steady_clock)建立最小堆,
+// carLoop 睡眠到最近的截止时间或小车状态变化时才被唤醒, 取代固定 5ms 轮询
+class UnloadScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+    struct Task {
+        clock::time_point deadline;     //下件触发时间
+        int carID;
+        uint64_t stepVersion;           //计算时的步进版本, 触发前校验小车是否仍在该位置
+        uint32_t generation;            //计算时该小车的代数, 小车被重新写入后旧任务作废
+    };
+
+    void schedule(const Task& task);
+    void clear();                       //步进后清空重新计算; 单辆小车变化时只追加新任务, 旧任务按代数作废
+    void notify();                      //状态变化, 唤醒调度线程
+    void start();
+    void stop();
+    // 阻塞直到: 有任务到期 / notify / stop. 到期任务放入 due; 返回 false 表示已停止
+    bool waitDue(std::vector<Task>& due);
+    size_t pending();
+
+private:
+    struct Later {
+        bool operator()(const Task& a, const Task& b) const { return a.deadline > b.deadline; }
+    };
+    static constexpr std::chrono::microseconds spinLead{ 1000 };    //最后 1ms 自旋等待, 减少系统定时器抖动
+
+    std::priority_queue<Task, std::vector<Task>, Later> heap_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool changed_ = false;
+    bool stopping_ = false;
+};
+
+#endif // UNLOADSCHEDULER_H
@@ -0,0 +1,102 @@
+#include "waybillcache.h"
+
+void WaybillCache::setCapacity(size_t totalEntries)
+{
+    size_t perShard = (totalEntries + ShardCount - 1) / ShardCount;
+    maxPerShard_ = perShard > 0 ? perShard : 1;
+}
+
+bool WaybillCache::find(const WaybillCode& code, Entry& out)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.index.find(code);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    out = it->second->entry;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool WaybillCache::touch(const WaybillCode& code, int carID, const std::string& scanTime, Entry& out)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.index.find(code);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    Entry& entry = it->second->entry;
+    entry.carID = carID;
+    entry.scanTime = scanTime;
+    out = entry;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+WaybillCache::Entry WaybillCache::merge(const WaybillCode& code, const Entry& entry)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.index.find(code);
+    if (it != shard.index.end()) {
+        Entry& cached = it->second->entry;
+        cached.carID = entry.carID;
+        cached.scanTime = entry.scanTime;
+        if (entry.slotID > 0) cached.slotID = entry.slotID;     //入库查询期间格口回传写入的格口保留
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return cached;
+    }
+    insertLocked(shard, code, entry);
+    return entry;
+}
+
+void WaybillCache::setSlot(const WaybillCode& code, int slotID)
+{
+    Shard& shard = shardFor(code);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto it = shard.index.find(code);
+    if (it != shard.index.end()) {
+        it->second->entry.slotID = slotID;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    Entry entry;
+    entry.slotID = slotID;
+    insertLocked(shard, code, entry);
+}
+
+void WaybillCache::insertLocked(Shard& shard, const WaybillCode& code, const Entry& entry)
+{
+    while (!shard.lru.empty() && shard.lru.size() >= maxPerShard_)     //分片已满, 淘汰最久未使用的记录
+    {
+        shard.index.erase(shard.lru.back().code);
+        shard.lru.pop_back();
+        evicted_.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.lru.push_front(Node{ code, entry });
+    shard.index[code] = shard.lru.begin();
+}
+
+size_t WaybillCache::size()
+{
+    size_t total = 0;
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lk(shard.mtx);
+        total += shard.lru.size();
+    }
+    return total;
+}
+
+std::string WaybillCache::summary()
+{
+    return "记录数: [" + std::to_string(size()) + "], 命中: [" + std::to_string(hits_.load(std::memory_order_relaxed))
+        + "], 未命中: [" + std::to_string(misses_.load(std::memory_order_relaxed))
+        + "], 淘汰: [" + std::to_string(evicted_.load(std::memory_order_relaxed)) + "]";
+}
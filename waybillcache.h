@@ -0,0 +1,54 @@
+#ifndef WAYBILLCACHE_H
+#define WAYBILLCACHE_H
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "waybillcode.h"
+
+// supply_data 的进程内缓存: 面单号 -> {格口号, 小车号, 扫码时间}. 按面单号哈希分片加锁, 每个分片按最近使用(LRU)淘汰.
+// 只缓存本程序写入或从数据库读到的状态, 重复扫码与格口回传直接查内存, 数据库只承担后台写入
+class WaybillCache {
+public:
+    static constexpr size_t ShardCount = 16;
+
+    struct Entry {
+        int slotID = -1;        //-1 = 已入库, 尚未请求到格口
+        int carID = 0;
+        std::string scanTime;
+    };
+
+    void setCapacity(size_t totalEntries);          //总容量, 平均分到各分片
+    bool find(const WaybillCode& code, Entry& out);
+    // 重复扫码: 命中时更新小车号与扫码时间, out 返回更新后的记录; 未命中返回 false 且不插入
+    bool touch(const WaybillCode& code, int carID, const std::string& scanTime, Entry& out);
+    // 写入入库结果: 已有记录只更新小车号与扫码时间, 已知格口(> 0)不会被未请求到格口的结果覆盖; 返回合并后的记录
+    Entry merge(const WaybillCode& code, const Entry& entry);
+    void setSlot(const WaybillCode& code, int slotID);      //格口回传, 未缓存时插入一条小车号未知的记录
+    size_t size();
+    uint64_t lookups() const { return hits_.load(std::memory_order_relaxed) + misses_.load(std::memory_order_relaxed); }
+    std::string summary();
+
+private:
+    struct Node {
+        WaybillCode code;
+        Entry entry;
+    };
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        std::list<Node> lru;        //表头为最近使用
+        std::unordered_map<WaybillCode, std::list<Node>::iterator> index;
+    };
+    Shard& shardFor(const WaybillCode& code) { return shards_[code.hash() % ShardCount]; }
+    void insertLocked(Shard& shard, const WaybillCode& code, const Entry& entry);
+
+    std::array<Shard, ShardCount> shards_;
+    size_t maxPerShard_ = 1024;
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+    std::atomic<uint64_t> evicted_{ 0 };
+};
+
+#endif // WAYBILLCACHE_H
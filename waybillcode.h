@@ -0,0 +1,78 @@
+#ifndef WAYBILLCODE_H
+#define WAYBILLCODE_H
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <functional>
+#include <type_traits>
+
+// 定长内联面单号(如 SF6093319807519), 不分配堆内存, 使 CarItem 可平凡复制, 快照/事件/映射表复制不再分配.
+// 最多 Capacity 个字符, 以 '\0' 结尾; 超长面单号无法保存, 由 fits() 在入口处拒绝
+class WaybillCode {
+public:
+    static constexpr size_t Capacity = 31;
+
+    WaybillCode() = default;
+    WaybillCode(const char* data, size_t len) { assign(data, len); }
+    explicit WaybillCode(const std::string& text) { assign(text.data(), text.size()); }
+
+    static bool fits(size_t len) { return len <= Capacity; }
+
+    void assign(const char* data, size_t len)
+    {
+        if (len > Capacity) len = Capacity;
+        std::memcpy(data_, data, len);
+        std::memset(data_ + len, 0, sizeof(data_) - len);      //尾部清零, 比较与哈希可按整块进行
+        size_ = static_cast<uint8_t>(len);
+    }
+    void clear()
+    {
+        std::memset(data_, 0, sizeof(data_));
+        size_ = 0;
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    const char* data() const { return data_; }
+    const char* c_str() const { return data_; }
+    std::string str() const { return std::string(data_, size_); }
+
+    bool operator==(const WaybillCode& other) const { return size_ == other.size_ && std::memcmp(data_, other.data_, size_) == 0; }
+    bool operator!=(const WaybillCode& other) const { return !(*this == other); }
+    bool operator<(const WaybillCode& other) const
+    {
+        int c = std::memcmp(data_, other.data_, sizeof(data_));    //尾部为 0, 与按字符串比较一致
+        return c < 0;
+    }
+
+    size_t hash() const     // FNV-1a
+    {
+        uint64_t h = 1469598103934665603ULL;
+        for (size_t i = 0; i < size_; ++i)
+        {
+            h ^= static_cast<uint8_t>(data_[i]);
+            h *= 1099511628211ULL;
+        }
+        return static_cast<size_t>(h);
+    }
+
+private:
+    char data_[Capacity + 1] = {};
+    uint8_t size_ = 0;
+};
+
+static_assert(std::is_trivially_copyable<WaybillCode>::value, "WaybillCode must be trivially copyable");
+
+namespace std {
+template <>
+struct hash<WaybillCode> {
+    size_t operator()(const WaybillCode& code) const { return code.hash(); }
+};
+}
+
+inline std::string operator+(const std::string& lhs, const WaybillCode& rhs) { return lhs + rhs.str(); }
+inline std::string operator+(const char* lhs, const WaybillCode& rhs) { return std::string(lhs) + rhs.str(); }
+inline std::string operator+(const WaybillCode& lhs, const std::string& rhs) { return lhs.str() + rhs; }
+inline std::string operator+(const WaybillCode& lhs, const char* rhs) { return lhs.str() + rhs; }
+
+#endif // WAYBILLCODE_H